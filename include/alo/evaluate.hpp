@@ -7,6 +7,9 @@ namespace alo {
 class Evaluator {
 public:
     static int evaluate(Board* pos);
+    // With the searcher's caches (may be NULL) and the caller's window;
+    // outside alpha..beta the result may be a cheap bound
+    static int evaluate(Board* pos, S_EVALTABLES* tables, int alpha, int beta);
 };
 
 } // namespace alo
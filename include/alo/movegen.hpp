@@ -8,7 +8,14 @@ class MoveGenerator {
 public:
     static void generateAll(Board *pos, MoveList *list);
     static void generateCaptures(Board *pos, MoveList *list);
+    static void generateQuiets(Board *pos, MoveList *list);
+    static void generateEvasions(Board *pos, MoveList *list);
+    static void generateQuietChecks(Board *pos, MoveList *list);
     static int moveExists(Board *pos, const int move);
+    static int isPseudoLegal(Board *pos, const int move);
+    static int isLegal(Board *pos, const int move);
+    static void initCheckSquares(const Board *pos, S_CHECKSQ *cs);
+    static int givesCheck(const Board *pos, const S_CHECKSQ *cs, const int move);
 };
 
 } // namespace alo
@@ -7,24 +7,28 @@ namespace alo {
 
 class Searcher {
 public:
-    Searcher(Board* p, SearchInfo* i);
+    Searcher(Board* p, SearchInfo* i, SearchData* d);
     void searchPosition();
 
     int searchScore(int depth, int time_ms = -1);
 private:
-    Board* pos;
+    Board* root;
     SearchInfo* info;
+    SearchData* data;
     TranspositionTable tt;
     void checkUp();
     void pickNextMove(int moveNum, MoveList *list);
+    void scoreQuiets(const Board *pos, MoveList *list, int first);
+    void makeChild(const Board *pos, Board *child, int move);
+    void leaveChild(const Board *pos);
     void clearForSearch();
-    int quiescence(int alpha, int beta);
-    int alphaBeta(int alpha, int beta, int depth, int doNull);
+    int quiescence(Board *pos, int alpha, int beta, int depth);
+    int alphaBeta(Board *pos, int alpha, int beta, int depth, int doNull);
 
     
 };
 
 } // namespace alo
 
-int SearchScore(Board *pos, SearchInfo *info, int depth, int time_ms = -1);
+int SearchScore(Board *pos, SearchInfo *info, SearchData *data, int depth, int time_ms = -1);
 
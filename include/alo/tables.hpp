@@ -0,0 +1,137 @@
+#pragma once
+
+// Tables that depend only on the board geometry, and the Zobrist keys, built
+// at compile time. Every build and every run sees the same values, so hash
+// files and shared tables stay valid between them. Included from types.hpp.
+
+namespace alo {
+namespace tables {
+
+struct SquareMaps {
+    int sq120To64[BOARD_SIZE];
+    int sq64To120[64];
+    int files[BOARD_SIZE];
+    int ranks[BOARD_SIZE];
+};
+
+constexpr SquareMaps makeSquareMaps() {
+    SquareMaps m{};
+    for(int index = 0; index < BOARD_SIZE; ++index) {
+        m.sq120To64[index] = 65;
+        m.files[index] = OFFBOARD;
+        m.ranks[index] = OFFBOARD;
+    }
+    int sq64 = 0;
+    for(int rank = RANK_1; rank <= RANK_8; ++rank) {
+        for(int file = FILE_A; file <= FILE_H; ++file) {
+            const int sq = FR2SQ(file, rank);
+            m.sq64To120[sq64] = sq;
+            m.sq120To64[sq] = sq64;
+            m.files[sq] = file;
+            m.ranks[sq] = rank;
+            sq64++;
+        }
+    }
+    return m;
+}
+
+struct Masks {
+    U64 set[64];
+    U64 clear[64];
+    U64 file[8];
+    U64 rank[8];
+    U64 whitePassed[64];
+    U64 blackPassed[64];
+    U64 isolated[64];
+    U64 pawnShield[64];
+};
+
+// Passed masks cover the pawn's file and the adjacent ones ahead of it; the
+// pawn shield is the 3x3 block (2 wide or tall at the edge) around a square
+constexpr Masks makeMasks() {
+    Masks m{};
+    for(int sq = 0; sq < 64; ++sq) {
+        m.set[sq] = 1ULL << sq;
+        m.clear[sq] = ~m.set[sq];
+        m.file[sq % 8] |= m.set[sq];
+        m.rank[sq / 8] |= m.set[sq];
+    }
+    for(int sq = 0; sq < 64; ++sq) {
+        const int file = sq % 8;
+        const int rank = sq / 8;
+        U64 files = m.file[file];
+        U64 ranks = m.rank[rank];
+        if(file > FILE_A) {
+            m.isolated[sq] |= m.file[file - 1];
+            files |= m.file[file - 1];
+        }
+        if(file < FILE_H) {
+            m.isolated[sq] |= m.file[file + 1];
+            files |= m.file[file + 1];
+        }
+        if(rank > RANK_1) ranks |= m.rank[rank - 1];
+        if(rank < RANK_8) ranks |= m.rank[rank + 1];
+        for(int r = rank + 1; r <= RANK_8; ++r) {
+            m.whitePassed[sq] |= files & m.rank[r];
+        }
+        for(int r = rank - 1; r >= RANK_1; --r) {
+            m.blackPassed[sq] |= files & m.rank[r];
+        }
+        m.pawnShield[sq] = files & ranks;
+    }
+    return m;
+}
+
+struct ZobristKeys {
+    U64 piece[13][BOARD_SIZE];
+    U64 side;
+    U64 castle[16];
+};
+
+// xorshift64* from a fixed seed
+constexpr U64 nextKey(U64 &state) {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+}
+
+constexpr ZobristKeys makeZobristKeys() {
+    ZobristKeys k{};
+    U64 state = 1070372ULL;
+    for(int pce = 0; pce < 13; ++pce) {
+        for(int sq = 0; sq < BOARD_SIZE; ++sq) {
+            k.piece[pce][sq] = nextKey(state);
+        }
+    }
+    k.side = nextKey(state);
+    for(int index = 0; index < 16; ++index) {
+        k.castle[index] = nextKey(state);
+    }
+    return k;
+}
+
+inline constexpr SquareMaps Squares = makeSquareMaps();
+inline constexpr Masks BitMasks = makeMasks();
+inline constexpr ZobristKeys Zobrist = makeZobristKeys();
+
+} // namespace tables
+} // namespace alo
+
+inline constexpr const int (&Sq120ToSq64)[BOARD_SIZE] = alo::tables::Squares.sq120To64;
+inline constexpr const int (&Sq64ToSq120)[64] = alo::tables::Squares.sq64To120;
+inline constexpr const int (&FilesBrd)[BOARD_SIZE] = alo::tables::Squares.files;
+inline constexpr const int (&RanksBrd)[BOARD_SIZE] = alo::tables::Squares.ranks;
+
+inline constexpr const U64 (&SetMask)[64] = alo::tables::BitMasks.set;
+inline constexpr const U64 (&ClearMask)[64] = alo::tables::BitMasks.clear;
+inline constexpr const U64 (&FileBBMask)[8] = alo::tables::BitMasks.file;
+inline constexpr const U64 (&RankBBMask)[8] = alo::tables::BitMasks.rank;
+inline constexpr const U64 (&WhitePassedMask)[64] = alo::tables::BitMasks.whitePassed;
+inline constexpr const U64 (&BlackPassedMask)[64] = alo::tables::BitMasks.blackPassed;
+inline constexpr const U64 (&IsolatedMask)[64] = alo::tables::BitMasks.isolated;
+inline constexpr const U64 (&PawnShield)[64] = alo::tables::BitMasks.pawnShield;
+
+inline constexpr const U64 (&PieceKeys)[13][BOARD_SIZE] = alo::tables::Zobrist.piece;
+inline constexpr const U64 &SideKey = alo::tables::Zobrist.side;
+inline constexpr const U64 (&CastleKeys)[16] = alo::tables::Zobrist.castle;
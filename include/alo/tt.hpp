@@ -13,15 +13,19 @@ public:
     void initDefault() { InitHashTable(table_); }
     void clear() { ClearHashTable(table_); }
     void reinitMB(int mb) { ReInitHashTable(table_, mb); }
+    void resetStats() { ResetHashStats(table_); }
+    int hashFull() const { return HashFull(table_); }
 
-    bool probe(Board* pos, int* move, int* score, int alpha, int beta, int depth) {
-        return ProbeHashEntry(pos, move, score, alpha, beta, depth) == TRUE;
+    bool probe(const Board* pos, int* move, int* score, int alpha, int beta, int depth) {
+        return ProbeHashEntry(table_, pos, move, score, alpha, beta, depth) == TRUE;
     }
-    void store(Board* pos, int move, int score, int flags, int depth) {
-        StoreHashEntry(pos, move, score, flags, depth);
+    void store(const Board* pos, int move, int score, int flags, int depth) {
+        StoreHashEntry(table_, pos, move, score, flags, depth);
     }
-    int probePvMove(const Board* pos) { return ProbePvMove(pos); }
-    int getPvLine(int depth, Board* pos) { return GetPvLine(depth, pos); }
+    // Pull the entry for posKey into cache ahead of the probe.
+    void prefetch(U64 posKey) const { __builtin_prefetch(&table_->pTable[posKey & table_->mask]); }
+    int probePvMove(const Board* pos) const { return ProbePvMove(pos, table_); }
+    int getPvLine(int depth, const Board* pos, int* pvArray) const { return GetPvLine(depth, pos, table_, pvArray); }
 
     S_HASHTABLE* raw() { return table_; }
     const S_HASHTABLE* raw() const { return table_; }
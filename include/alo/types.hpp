@@ -3,10 +3,15 @@
 #include "stdio.h"
 #include "stdlib.h"
 
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
 #define BOARD_SIZE 120
 #define MAX_GAME_MOVES 2048
 #define MAX_POSITION_MOVES 256
 #define MAX_DEPTH 64
+#define KEY_FILTER_SIZE 4096
 
 // Scoring constants
 constexpr int SCORE_INF = 30000;
@@ -39,6 +44,8 @@ enum { RANK_1, RANK_2, RANK_3, RANK_4, RANK_5, RANK_6, RANK_7, RANK_8, RANK_NONE
 
 enum { WHITE, BLACK, BOTH };
 
+enum { MG, EG };
+
 enum {
     A1 = 21, B1, C1, D1, E1, F1, G1, H1,
     A2 = 31, B2, C2, D2, E2, F2, G2, H2,
@@ -56,27 +63,35 @@ enum { FALSE, TRUE };
 
 enum { WKCA = 1, WQCA = 2, BKCA = 4, BQCA = 8 };
 
+// Ray directions on the 64-square board; the first four step to higher squares
+enum { NORTH, EAST, NORTHEAST, NORTHWEST, SOUTH, WEST, SOUTHEAST, SOUTHWEST };
+
+// Sliding attacks for one square: the relevant occupancy mask selects the
+// blockers, which index into that square's slice of the attack table
 typedef struct {
-    int move;
-    int score;
-} S_MOVE;
-
-// 0000 0000 0000 0000 0000 0111 1111 -> From (0x7F)
-// 0000 0000 0000 0011 1111 1000 0000 -> To (>> 7,  0x7F)
-// 0000 0000 0011 1100 0000 0000 0000 -> Captured (>> 14, 0xF)
-// 0000 0000 0100 0000 0000 0000 0000 -> EnPas (0x40000)
-// 0000 0000 1000 0000 0000 0000 0000 -> Pawn Start (0x80000)
-// 0000 1111 0000 0000 0000 0000 0000 -> Promotion (>> 20, 0xF)
-// 0001 0000 1000 0000 0000 0000 0000 -> Castled (0x1000000)
+    U64 mask;
+    U64 magic;
+    U64 *attacks;
+    int shift;
+} S_MAGIC;
+
+// Moves fit in 16 bits; squares are 64-based and the captured piece is
+// read from the board rather than stored
+// 0000 0000 0011 1111 -> From (0x3F)
+// 0000 1111 1100 0000 -> To (>> 6, 0x3F)
+// 1111 0000 0000 0000 -> Flag (>> 12): 0 quiet, 1 pawn start, 2 castle,
+//                        4 capture, 5 en passant, 8-11 promotion to
+//                        N/B/R/Q, 12-15 promotion with capture
 
 enum { HFNONE, HFALPHA, HFBETA, HFEXACT };
 
 typedef struct {
     U64 posKey;
-    int move;
+    unsigned short move;
     short score;
     unsigned char depth;
     unsigned char flags;
+    unsigned short spare; // keeps the data half a full word
 } S_HASHENTRY;
 
 typedef struct{
@@ -89,55 +104,112 @@ typedef struct {
     U64 mask;       // numEntries - 1
     int newWrite;
     int overWrite;
+    // Per-search instrumentation, reset by ResetHashStats
+    long probes;
+    long hits;       // key matched
+    long cuts;       // hit returned a usable bound
+    long collisions; // slot held a different position
+    long skipWrite;  // store rejected in favour of a deeper entry
+    // Named POSIX shared-memory backing; NULL when the table is private
+    void *shared;
+    size_t sharedBytes;
+    int sharedFd;
+    char sharedName[64];
 } S_HASHTABLE;
 
+// Moves and their ordering scores in separate arrays
 typedef struct {
-    int move;
-    int castlePerm;
-    int enPas;
-    int fiftyMove;
-    U64 posKey;
-} Undo;
-
-typedef struct {
-    S_MOVE moves[MAX_POSITION_MOVES];
+    unsigned short moves[MAX_POSITION_MOVES];
+    int scores[MAX_POSITION_MOVES];
     int count;
 } MoveList;
 
-// Object-oriented Board with method helpers; fields remain public to minimize churn
+// Squares each piece type attacks, built at most once per node and shared by
+// check detection and the evaluation. Pawn, knight and king attacks
+// ignore what stands on the target; sliders stop at the first piece.
+typedef struct {
+    U64 byPiece[13];    // union over all pieces of that type
+    U64 all[2];         // attacked by anything of that colour
+    U64 twice[2];       // attacked by at least two pieces of that colour
+    short mobility[13]; // per piece type, summed piece by piece: squares
+                        // reached outside own pieces and enemy pawn attacks
+} S_ATTACKS;
+
+// Pawn-structure terms depend only on the pawns, so they are cached by
+// pawnKey. A slot is valid whenever its key matches; nothing goes stale.
+#define PAWN_TABLE_SIZE 8192
+typedef struct {
+    U64 key;
+    U64 passed;     // passed pawns of both colours
+    short score[2]; // white-relative, [MG] and [EG]
+} S_PAWNENTRY;
+
+// Everything that follows from the piece counts alone, cached by materialKey.
+// scale is out of SCALE_NORMAL and applies while that colour is ahead.
+#define MATERIAL_TABLE_SIZE 2048
+#define SCALE_NORMAL 64
+namespace alo { struct Board; }
+typedef int (*EndgameFn)(const alo::Board *pos);
+typedef int (*ScaleFn)(const alo::Board *pos, int strong);
+typedef struct {
+    U64 key;
+    EndgameFn endgame;       // replaces the evaluation when set
+    ScaleFn scaling[2];      // replaces scale[] for that colour when set
+    short imbalance;         // white-relative
+    unsigned char scale[2];
+    unsigned char draw;      // dead draw whatever the squares
+} S_MATERIALENTRY;
+
+// Caches the evaluation keeps between calls, owned by the searcher
+typedef struct {
+    S_PAWNENTRY pawns[PAWN_TABLE_SIZE];
+    S_MATERIALENTRY material[MATERIAL_TABLE_SIZE];
+    // Attack map of the node at each ply, valid while its key is the node's
+    // posKey; kept here so the copied Board stays small
+    S_ATTACKS attacks[MAX_DEPTH];
+    U64 attacksKey[MAX_DEPTH];
+} S_EVALTABLES;
+
+// Filled once per node so GivesCheck can answer without making the move
+typedef struct {
+    U64 checkSq[13];  // squares from which each of our pieces would check
+    U64 discovered;   // our pieces whose move can uncover a check
+    int theirKingSq;  // 64-based
+} S_CHECKSQ;
+
+// Object-oriented Board with method helpers; fields remain public to minimize churn.
+// Only the position itself lives here, so the search copies it at every ply
+// instead of undoing moves; see SearchData for the game and search tables.
 namespace alo {
 struct Board {
     // data
-    int pieces[120];
-    U64 pawns[3];
+    U64 pceBB[13];   // per piece, 64-square indexed
+    U64 occBB[3];    // occupancy by colour, BOTH for all pieces
+    U64 posKey;
+    U64 pawnKey;       // pawns only
+    U64 materialKey;   // piece counts, not squares
+    U64 nonPawnKey[2]; // pieces and king of each colour
+
+    unsigned char pieces[BOARD_SIZE];
+    unsigned char pceNum[13];
+    unsigned char bigPce[2];
+    unsigned char majPce[2];
+    unsigned char minPce[2];
 
     int kingSq[2];
     int side;
     int enPas;
     int fiftyMove;
+    int pliesFromNull; // no repetition reaches back across a null move
 
     int ply;
     int hisPly;
 
     int castlePerm;
 
-    U64 posKey;
-    int pceNum[13];
-    int bigPce[3];
-    int majPce[3];
-    int minPce[3];
-
     int material[2];
-
-    Undo history[MAX_GAME_MOVES];
-
-    int plist[13][10];
-
-    S_HASHTABLE HashTable[1];
-    int PvArray[MAX_DEPTH];
-
-    int searchHistory[13][BOARD_SIZE];
-    int searchKillers[2][MAX_DEPTH];
+    int psq[2];     // white-relative piece-square sum, [MG] and [EG]
+    int phase;      // PHASE_MAX with all pieces on, 0 with only kings and pawns
 
     // methods
     void updateListsMaterials();
@@ -202,6 +274,20 @@ typedef struct {
     float fhf;
 } SearchInfo;
 
+// Everything the search needs besides the position: keys of the game so far
+// for repetition, the hash table, the evaluation caches and the
+// move-ordering tables
+typedef struct {
+    U64 gameKeys[MAX_GAME_MOVES]; // posKey before the move made at each hisPly
+    unsigned char keyFilter[KEY_FILTER_SIZE]; // count of path keys per low-bit bucket
+    S_HASHTABLE HashTable[1];
+    S_EVALTABLES evalTables[1];
+    int PvArray[MAX_DEPTH];
+
+    int searchHistory[13][BOARD_SIZE];
+    unsigned short searchKillers[2][MAX_DEPTH];
+} SearchData;
+
 
 
 
@@ -219,30 +305,36 @@ typedef struct {
 #define IsKi(p) (PieceKing[(p)])
 #define IsKn(p) (PieceKnight[(p)])
 
-#define FROMSQ(m) ((m)&0x7F)
-#define TOSQ(m) (((m) >> 7) & 0x7F)
-#define CAPTURED(m) (((m) >> 14) & 0xF)
-#define PROMOTED(m) (((m) >> 20) & 0xF)
-#define MFLAGEP 0x40000
-#define MFLAGPS 0x80000
-#define MFLAGCA 0x1000000
-
-#define MFLAGCAP 0x7c000
-#define MFLAGPROM 0xF00000
+#define FROM64(m) ((m) & 0x3F)
+#define TO64(m) (((m) >> 6) & 0x3F)
+#define FROMSQ(m) SQ120(FROM64(m))
+#define TOSQ(m) SQ120(TO64(m))
+#define MFLAG(m) ((m) & 0xF000)
+#define MFLAGPS 0x1000
+#define MFLAGCA 0x2000
+#define MFLAGCAP 0x4000
+#define MFLAGEP 0x5000
+#define MFLAGPROM 0x8000
+
+// Flags are a code, not independent bits; only CAP and PROM can be tested alone
+#define ISPS(m) (MFLAG(m) == MFLAGPS)
+#define ISCA(m) (MFLAG(m) == MFLAGCA)
+#define ISEP(m) (MFLAG(m) == MFLAGEP)
+#define ISPROM(m) ((m) & MFLAGPROM)
+// Promotion piece of the given side, EMPTY when the move does not promote
+#define PROMOTED(m, side) (ISPROM(m) ? ((side) == WHITE ? wN : bN) + (((m) >> 12) & 3) : EMPTY)
 
 #define NOMOVE 0
 
 // Globals
-extern int Sq120ToSq64[BOARD_SIZE];
-extern int Sq64ToSq120[64];
-extern U64 SetMask[64];
-extern U64 ClearMask[64];
-extern U64 PieceKeys[13][120];
-extern U64 SideKey;
-extern U64 CastleKeys[16];
+#include "alo/tables.hpp"
 
-extern int FilesBrd[BOARD_SIZE];
-extern int RanksBrd[BOARD_SIZE];
+// Cuckoo tables of reversible moves, keyed by the Zobrist difference they make
+#define CUCKOO_SIZE 8192
+#define CUCKOO_H1(key) ((int)((key) & 0x1fff))
+#define CUCKOO_H2(key) ((int)(((key) >> 16) & 0x1fff))
+extern U64 CuckooKeys[CUCKOO_SIZE];
+extern unsigned short CuckooMoves[CUCKOO_SIZE];
 
 extern char PceChar[];
 extern char SideChar[];
@@ -254,6 +346,7 @@ extern int PieceMaj[13];
 extern int PieceMin[13];
 extern int PieceVal[13];
 extern int PieceCol[13];
+extern int PiecePhase[13];
 extern int PiecePawn[13];
 
 extern int PieceKnight[13];
@@ -262,17 +355,16 @@ extern int PieceRookQueen[13];
 extern int PieceBishopQueen[13];
 extern int PieceSlides[13];
 
-// (dedup) FilesBrd/RanksBrd declared once above
-
 extern int Mirror64[64];
 
-extern U64 FileBBMask[8];
-extern U64 RankBBMask[8];
-
-extern U64 BlackPassedMask[64];
-extern U64 WhitePassedMask[64];
-extern U64 IsolatedMask[64];
-extern U64 PawnShield[64];
+extern U64 KnightAttacks[64];
+extern U64 KingAttacks[64];
+extern U64 PawnAttacks[2][64];
+extern U64 RayMasks[8][64];
+extern U64 BetweenBB[64][64];
+extern U64 LineBB[64][64];
+extern S_MAGIC BishopMagics[64];
+extern S_MAGIC RookMagics[64];
 
 // init.c
 extern void AllInit();
@@ -284,6 +376,10 @@ extern int CountBit(U64 b);
 
 // hashkeys.c
 extern U64 GeneratePosKey(const Board *pos);
+extern U64 GeneratePawnKey(const Board *pos);
+extern U64 GenerateMaterialKey(const Board *pos);
+extern U64 GenerateNonPawnKey(const Board *pos, int col);
+extern U64 HashKeyFingerprint();
 
 // board.c
 extern void UpdateListsMaterials(Board *pos);
@@ -294,6 +390,33 @@ extern int CheckBoard(Board *pos);
 
 // attack.c
 extern int SqAttacked(const int sq, const int side, Board *pos);
+extern U64 AttackersTo(const Board *pos, const int sq64, const U64 occ);
+extern void ComputeAttacks(const Board *pos, S_ATTACKS *attacks);
+extern const S_ATTACKS *GetAttacks(const Board *pos, S_EVALTABLES *tables, S_ATTACKS *local);
+extern int InCheck(Board *pos, const S_EVALTABLES *tables);
+
+#if defined(__BMI2__)
+#define MAGIC_INDEX(m, occ) _pext_u64((occ), (m)->mask)
+#else
+#define MAGIC_INDEX(m, occ) ((((occ) & (m)->mask) * (m)->magic) >> (m)->shift)
+#endif
+
+inline U64 BishopAttacks(const int sq, const U64 occ) {
+    const S_MAGIC *m = &BishopMagics[sq];
+    return m->attacks[MAGIC_INDEX(m, occ)];
+}
+
+inline U64 RookAttacks(const int sq, const U64 occ) {
+    const S_MAGIC *m = &RookMagics[sq];
+    return m->attacks[MAGIC_INDEX(m, occ)];
+}
+
+// King moves between two 64-based squares
+inline int SqDistance(const int sq1, const int sq2) {
+    const int df = abs(sq1 % 8 - sq2 % 8);
+    const int dr = abs(sq1 / 8 - sq2 / 8);
+    return df > dr ? df : dr;
+}
 
 // io.c
 extern char *PrMove(const int move);
@@ -305,9 +428,15 @@ extern void PrintBin(int move);
 // movegen.c
 extern void GenerateAllMoves(Board *pos, MoveList *list);
 extern void GenerateAllCaptures(Board *pos, MoveList *list);
+extern void GenerateQuiets(Board *pos, MoveList *list);
+extern void GenerateEvasions(Board *pos, MoveList *list);
+extern void GenerateQuietChecks(Board *pos, MoveList *list);
 extern int MoveExists(Board *pos, const int move);
+extern int IsPseudoLegal(Board *pos, const int move);
+extern int IsLegal(Board *pos, const int move);
+extern void InitCheckSquares(const Board *pos, S_CHECKSQ *cs);
+extern int GivesCheck(const Board *pos, const S_CHECKSQ *cs, const int move);
 extern int InitMvvLva();
-extern void TakeNullMove(Board *pos);
 extern void MakeNullMove(Board *pos);
 
 // validate.c
@@ -318,27 +447,45 @@ extern int PieceValidEmpty(const int pce);
 extern int PieceValid(const int pce);
 
 // makemove.c
-extern int MakeMove(Board *pos, int move);
-extern void TakeMove(Board *pos);
+extern void MakeMove(Board *pos, int move);
+extern void MakeGameMove(Board *pos, SearchData *data, int move);
+extern U64 KeyAfterMove(const Board *pos, const int move);
 
 // perft.c
 extern void PerftTest(int depth, Board *pos);
 
 // pvtable.c
-extern void StoreHashEntry(Board *pos, const int move, int score, const int flags, const int depth);
-extern int ProbeHashEntry(Board *pos, int *move, int *score, int alpha, int beta, int depth);
+extern void StoreHashEntry(S_HASHTABLE *table, const Board *pos, const int move, int score, const int flags, const int depth);
+extern int ProbeHashEntry(S_HASHTABLE *table, const Board *pos, int *move, int *score, int alpha, int beta, int depth);
 extern void InitHashTable(S_HASHTABLE *table);
 extern void ClearHashTable(S_HASHTABLE *table);
 extern void ReInitHashTable(S_HASHTABLE *table, int megabytes);
-extern int GetPvLine(const int depth, Board *pos);
-extern int ProbePvMove(const Board *pos);
+extern int GetPvLine(const int depth, const Board *pos, const S_HASHTABLE *table, int *pvArray);
+extern int ProbePvMove(const Board *pos, const S_HASHTABLE *table);
+extern int HashFull(const S_HASHTABLE *table);
+extern void ResetHashStats(S_HASHTABLE *table);
+extern int SaveHashTable(const S_HASHTABLE *table, const char *path);
+extern int LoadHashTable(S_HASHTABLE *table, const char *path);
+extern int AttachSharedHashTable(S_HASHTABLE *table, const char *name, int megabytes);
+extern void FreeHashTable(S_HASHTABLE *table);
 
 // evaluate.c
+#define PHASE_MAX 24
+extern int PsqTable[2][13][64];
+extern void InitPsqTables();
 extern int EvaluatePosition(Board *pos);
+extern int EvaluateInWindow(Board *pos, S_EVALTABLES *tables, int alpha, int beta);
+extern void ClearEvalTables(S_EVALTABLES *tables);
+
+// endgame.c
+extern void InitEndgames();
+extern EndgameFn FindEndgame(const Board *pos);
+extern ScaleFn FindScaling(const Board *pos, int strong);
 
 // search.c
-extern int IsRepetition(const Board *pos);
-extern void SearchPosition(Board *pos, SearchInfo *info);
+extern int IsRepetition(const Board *pos, const SearchData *data);
+extern int HasGameCycle(const Board *pos, const SearchData *data);
+extern void SearchPosition(Board *pos, SearchInfo *info, SearchData *data);
 
 // misc.c
 extern int GetTimeMS();
@@ -7,8 +7,8 @@ namespace alo {
 class Uci {
 public:
     void loop();
-    void parseGo(char *line, SearchInfo *info, Board *pos);
-    void parsePosition(const char *lineIn, Board *pos);
+    void parseGo(char *line, SearchInfo *info, Board *pos, SearchData *data);
+    void parsePosition(const char *lineIn, Board *pos, SearchData *data);
 };
 
 } // namespace alo
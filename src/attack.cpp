@@ -1,77 +1,123 @@
 #include "alo/types.hpp"
 
-const int KnDir[8] = {-8, -19, -21, -12, 8, 19, 21, 12};
-const int RkDir[4] = {-1, -10, 1, 10};
-const int BiDir[4] = {-9, -11, 11, 9};
-const int KiDir[8] = {-1, -10, 1, 10, -9, -11, 11, 9};
-
 int SqAttacked(const int sq, const int side, Board *pos) {
-    int pce, index, t_sq, dir;
-
     ASSERT(SqOnBoard(sq));
     ASSERT(SideValid(side));
     ASSERT(CheckBoard(pos));
-    
-    //Pawns
-    if(side == WHITE) {
-        if(pos->pieces[sq - 11] == wP || pos->pieces[sq - 9] == wP) {
-            return TRUE;
-        }
-    } else {
-        if(pos->pieces[sq + 11] == bP || pos->pieces[sq + 9] == bP) {
-            return TRUE;
-        }
+
+    const int sq64 = SQ64(sq);
+    const U64 occ = pos->occBB[BOTH];
+
+    //Pawns: a pawn of side attacks sq64 from where an opposing pawn on sq64 would capture
+    if(PawnAttacks[side ^ 1][sq64] & pos->pceBB[side == WHITE ? wP : bP]) {
+        return TRUE;
     }
 
     //Knights
-    for(index = 0; index < 8; ++index) {
-        pce = pos->pieces[sq + KnDir[index]];
-        if(pce != OFFBOARD && IsKn(pce) && PieceCol[pce] == side) {
-            return TRUE;
-        }
+    if(KnightAttacks[sq64] & pos->pceBB[side == WHITE ? wN : bN]) {
+        return TRUE;
+    }
+
+    //Kings
+    if(KingAttacks[sq64] & pos->pceBB[side == WHITE ? wK : bK]) {
+        return TRUE;
     }
 
     //Rooks, Queens
-    for(index = 0; index < 4; ++index) {
-        dir = RkDir[index];
-        t_sq = sq + dir;
-        pce = pos->pieces[t_sq];
-        while(pce != OFFBOARD) {
-            if(pce != EMPTY) {
-                if(IsRQ(pce) && PieceCol[pce] == side) {
-                    return TRUE;
-                }
-                break;
-            }
-            t_sq += dir;
-            pce = pos->pieces[t_sq];
-        }
+    U64 rookQueens = side == WHITE ? (pos->pceBB[wR] | pos->pceBB[wQ]) : (pos->pceBB[bR] | pos->pceBB[bQ]);
+    if(rookQueens && (RookAttacks(sq64, occ) & rookQueens)) {
+        return TRUE;
     }
 
     //Bishops, Queens
-    for(index = 0; index < 4; ++index) {
-        dir = BiDir[index];
-        t_sq = sq + dir;
-        pce = pos->pieces[t_sq];
-        while(pce != OFFBOARD) {
-            if(pce != EMPTY) {
-                if(IsBQ(pce) && PieceCol[pce] == side) {
-                    return TRUE;
-                }
-                break;
-            }
-            t_sq += dir;
-            pce = pos->pieces[t_sq];
+    U64 bishopQueens = side == WHITE ? (pos->pceBB[wB] | pos->pceBB[wQ]) : (pos->pceBB[bB] | pos->pceBB[bQ]);
+    if(bishopQueens && (BishopAttacks(sq64, occ) & bishopQueens)) {
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+// Pieces of both colours attacking sq64 (64-based), with sliders seeing
+// through whatever is missing from occ
+U64 AttackersTo(const Board *pos, const int sq64, const U64 occ) {
+    const U64 *bb = pos->pceBB;
+    return (PawnAttacks[BLACK][sq64] & bb[wP])
+         | (PawnAttacks[WHITE][sq64] & bb[bP])
+         | (KnightAttacks[sq64] & (bb[wN] | bb[bN]))
+         | (KingAttacks[sq64] & (bb[wK] | bb[bK]))
+         | (RookAttacks(sq64, occ) & (bb[wR] | bb[bR] | bb[wQ] | bb[bQ]))
+         | (BishopAttacks(sq64, occ) & (bb[wB] | bb[bB] | bb[wQ] | bb[bQ]));
+}
+
+static inline void AddAttacks(S_ATTACKS *attacks, const int pce, const U64 bb) {
+    const int col = PieceCol[pce];
+    attacks->byPiece[pce] |= bb;
+    attacks->twice[col] |= attacks->all[col] & bb;
+    attacks->all[col] |= bb;
+}
+
+void ComputeAttacks(const Board *pos, S_ATTACKS *attacks) {
+    const U64 occ = pos->occBB[BOTH];
+    int pce;
+
+    for(pce = EMPTY; pce <= bK; ++pce) {
+        attacks->byPiece[pce] = 0ULL;
+        attacks->mobility[pce] = 0;
+    }
+    attacks->all[WHITE] = attacks->all[BLACK] = 0ULL;
+    attacks->twice[WHITE] = attacks->twice[BLACK] = 0ULL;
+
+    // Pawns in two shifts, so a square hit from both sides counts twice
+    const U64 wp = pos->pceBB[wP];
+    const U64 bp = pos->pceBB[bP];
+    AddAttacks(attacks, wP, (wp & ~FileBBMask[FILE_A]) << 7);
+    AddAttacks(attacks, wP, (wp & ~FileBBMask[FILE_H]) << 9);
+    AddAttacks(attacks, bP, (bp & ~FileBBMask[FILE_H]) >> 7);
+    AddAttacks(attacks, bP, (bp & ~FileBBMask[FILE_A]) >> 9);
+
+    // Pawn attacks are complete, so each piece's mobility can be counted on
+    // its own; the byPiece union would merge squares two pieces share
+    for(pce = wN; pce <= bK; ++pce) {
+        if(PiecePawn[pce]) continue;
+        const int col = PieceCol[pce];
+        const U64 area = ~pos->occBB[col] & ~attacks->byPiece[col == WHITE ? bP : wP];
+        U64 pieces = pos->pceBB[pce];
+        while(pieces) {
+            const int sq64 = POP(&pieces);
+            U64 bb = 0ULL;
+            if(IsKn(pce)) bb = KnightAttacks[sq64];
+            else if(IsKi(pce)) bb = KingAttacks[sq64];
+            if(IsBQ(pce)) bb |= BishopAttacks(sq64, occ);
+            if(IsRQ(pce)) bb |= RookAttacks(sq64, occ);
+            AddAttacks(attacks, pce, bb);
+            attacks->mobility[pce] += CNT(bb & area);
         }
     }
+}
 
-    //Kings
-    for(index = 0; index < 8; ++index) {
-        pce = pos->pieces[sq + KiDir[index]];
-        if(pce != OFFBOARD && IsKi(pce) && PieceCol[pce] == side) {
-            return TRUE;
+// The node's attack map: the one cached for its ply when there are tables,
+// built on first use; otherwise built into local
+const S_ATTACKS *GetAttacks(const Board *pos, S_EVALTABLES *tables, S_ATTACKS *local) {
+    S_ATTACKS *attacks = local;
+    if(tables && pos->ply < MAX_DEPTH) {
+        attacks = &tables->attacks[pos->ply];
+        if(tables->attacksKey[pos->ply] == pos->posKey) {
+            return attacks;
         }
+        tables->attacksKey[pos->ply] = pos->posKey;
     }
+    ComputeAttacks(pos, attacks);
+    return attacks;
+}
 
-    return FALSE;
+// Reads the map when the node already has one; otherwise a direct test,
+// so nodes that never reach the full evaluation do not pay for the map
+int InCheck(Board *pos, const S_EVALTABLES *tables) {
+    if(tables && pos->ply < MAX_DEPTH && tables->attacksKey[pos->ply] == pos->posKey) {
+        const int inCheck = (tables->attacks[pos->ply].all[pos->side ^ 1] & pos->pceBB[pos->side == WHITE ? wK : bK]) != 0;
+        ASSERT(inCheck == SqAttacked(pos->kingSq[pos->side], pos->side ^ 1, pos));
+        return inCheck;
+    }
+    return SqAttacked(pos->kingSq[pos->side], pos->side ^ 1, pos);
 }
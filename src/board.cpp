@@ -7,25 +7,33 @@ int Board::check() const {
     int t_majPce[2] = {0};
     int t_minPce[2] = {0};
     int t_material[2] = {0};
+    int t_psq[2] = {0};
+    int t_phase = 0;
 
-    int sq64, t_piece, t_pce_num, sq120, colour, pcount;
+    int sq64, t_piece, sq120, colour;
 
-    U64 t_pawns[3] = {0ULL};
-
-    t_pawns[WHITE] = pawns[WHITE];
-    t_pawns[BLACK] = pawns[BLACK];
-    t_pawns[BOTH] = pawns[BOTH];
+    U64 t_occ[3] = {0ULL};
 
     for(t_piece = wP; t_piece <= bK; ++t_piece) {
-        for(t_pce_num = 0; t_pce_num < pceNum[t_piece]; ++t_pce_num) {
-            sq120 = plist[t_piece][t_pce_num];
-            ASSERT(pieces[sq120] == t_piece);
+        U64 bb = pceBB[t_piece];
+        ASSERT(CNT(bb) == pceNum[t_piece]);
+        t_occ[PieceCol[t_piece]] |= bb;
+        while(bb) {
+            sq64 = POP(&bb);
+            ASSERT(pieces[SQ120(sq64)] == t_piece);
         }
     }
+    t_occ[BOTH] = t_occ[WHITE] | t_occ[BLACK];
+
+    ASSERT(t_occ[WHITE] == occBB[WHITE]);
+    ASSERT(t_occ[BLACK] == occBB[BLACK]);
+    ASSERT(t_occ[BOTH] == occBB[BOTH]);
+    ASSERT((t_occ[WHITE] & t_occ[BLACK]) == 0ULL);
 
     for(sq64 = 0; sq64 < 64; ++sq64) {
         sq120 = SQ120(sq64);
         t_piece = pieces[sq120];
+        if(t_piece == EMPTY) continue;
         t_pceNum[t_piece]++;
         colour = PieceCol[t_piece];
         if(PieceBig[t_piece] == TRUE) t_bigPce[colour]++;
@@ -33,41 +41,28 @@ int Board::check() const {
         if(PieceMaj[t_piece] == TRUE) t_majPce[colour]++;
 
         t_material[colour] += PieceVal[t_piece];
+        t_psq[MG] += PsqTable[MG][t_piece][sq64];
+        t_psq[EG] += PsqTable[EG][t_piece][sq64];
+        t_phase += PiecePhase[t_piece];
     }
 
     for(t_piece = wP; t_piece <= bK; ++t_piece) {
         ASSERT(t_pceNum[t_piece] == pceNum[t_piece]);
     }
 
-    pcount = CNT(t_pawns[WHITE]);
-    ASSERT(pcount == pceNum[wP]);
-    pcount = CNT(t_pawns[BLACK]);
-    ASSERT(pcount == pceNum[bP]);
-    pcount = CNT(t_pawns[BOTH]);
-    ASSERT(pcount == (pceNum[bP] + pceNum[wP]));
-
-    while(t_pawns[WHITE]) {
-        sq64 = POP(&t_pawns[WHITE]);
-        ASSERT(pieces[SQ120(sq64)] == wP);
-    }
-
-    while(t_pawns[BLACK]) {
-        sq64 = POP(&t_pawns[BLACK]);
-        ASSERT(pieces[SQ120(sq64)] == bP);
-    }
-
-    while(t_pawns[BOTH]) {
-        sq64 = POP(&t_pawns[BOTH]);
-        ASSERT((pieces[SQ120(sq64)] == bP) || (pieces[SQ120(sq64)] == wP));
-    }
-
     ASSERT(t_material[WHITE] == material[WHITE] && t_material[BLACK] == material[BLACK]);
+    ASSERT(t_psq[MG] == psq[MG] && t_psq[EG] == psq[EG]);
+    ASSERT(t_phase == phase);
     ASSERT(t_minPce[WHITE] == minPce[WHITE] && t_minPce[BLACK] == minPce[BLACK]);
     ASSERT(t_majPce[WHITE] == majPce[WHITE] && t_majPce[BLACK] == majPce[BLACK]);
     ASSERT(t_bigPce[WHITE] == bigPce[WHITE] && t_bigPce[BLACK] == bigPce[BLACK]);
 
     ASSERT(side == WHITE || side == BLACK);
     ASSERT(GeneratePosKey(this) == posKey);
+    ASSERT(GeneratePawnKey(this) == pawnKey);
+    ASSERT(GenerateMaterialKey(this) == materialKey);
+    ASSERT(GenerateNonPawnKey(this, WHITE) == nonPawnKey[WHITE]);
+    ASSERT(GenerateNonPawnKey(this, BLACK) == nonPawnKey[BLACK]);
 
     ASSERT(enPas == NO_SQ || (RanksBrd[enPas] == RANK_6 && side == WHITE) || (RanksBrd[enPas] == RANK_3 && side == BLACK));
     ASSERT(pieces[kingSq[WHITE]] == wK);
@@ -91,20 +86,18 @@ void Board::updateListsMaterials() {
             if(PieceMaj[piece] == TRUE) majPce[colour]++;
 
             material[colour] += PieceVal[piece];
+            psq[MG] += PsqTable[MG][piece][SQ64(sq)];
+            psq[EG] += PsqTable[EG][piece][SQ64(sq)];
+            phase += PiecePhase[piece];
 
-            plist [piece][pceNum[piece]] = sq;
             pceNum[piece]++;
 
             if(piece == wK) kingSq[WHITE] = sq;
             if(piece == bK) kingSq[BLACK] = sq;
 
-            if(piece == wP) {
-                SETBIT(pawns[WHITE], SQ64(sq));
-                SETBIT(pawns[BOTH], SQ64(sq));
-            } else if(piece == bP) {
-                SETBIT(pawns[BLACK], SQ64(sq));
-                SETBIT(pawns[BOTH], SQ64(sq));
-            }
+            SETBIT(pceBB[piece], SQ64(sq));
+            SETBIT(occBB[colour], SQ64(sq));
+            SETBIT(occBB[BOTH], SQ64(sq));
         }
         
     }
@@ -197,10 +190,14 @@ int Board::parseFEN(const char *fen) {
         enPas = FR2SQ(file, rank);
     }
 
-    posKey = GeneratePosKey(this);
-
     updateListsMaterials();
 
+    posKey = GeneratePosKey(this);
+    pawnKey = GeneratePawnKey(this);
+    materialKey = GenerateMaterialKey(this);
+    nonPawnKey[WHITE] = GenerateNonPawnKey(this, WHITE);
+    nonPawnKey[BLACK] = GenerateNonPawnKey(this, BLACK);
+
     return 0;
 }
 
@@ -222,16 +219,17 @@ void Board::reset() {
         majPce[index] = 0;
         minPce[index] = 0;
         material[index] = 0;
-        pawns[index] = 0ULL;
-        material[index] = 0;
+        psq[index] = 0;
     }
+    phase = 0;
 
     for(index = 0; index < 3; ++index) {
-        pawns[index] = 0ULL;
+        occBB[index] = 0ULL;
     }
 
     for(index = 0; index < 13; ++index) {
         pceNum[index] = 0;
+        pceBB[index] = 0ULL;
     }
 
     kingSq[WHITE] = kingSq[BLACK] = NO_SQ;
@@ -239,12 +237,16 @@ void Board::reset() {
     side = BOTH;
     enPas = NO_SQ;
     fiftyMove = 0;
+    pliesFromNull = 0;
     
     ply = 0;
     hisPly = 0;
 
     castlePerm = 0;
     posKey = 0ULL;
+    pawnKey = 0ULL;
+    materialKey = 0ULL;
+    nonPawnKey[WHITE] = nonPawnKey[BLACK] = 0ULL;
 
 
 }
@@ -379,9 +381,13 @@ void Board::mirror() {
     castlePerm = tempCastlePerm;
     enPas = tempEnPas;
 
-    posKey = GeneratePosKey(this);
-
     updateListsMaterials();
+
+    posKey = GeneratePosKey(this);
+    pawnKey = GeneratePawnKey(this);
+    materialKey = GenerateMaterialKey(this);
+    nonPawnKey[WHITE] = GenerateNonPawnKey(this, WHITE);
+    nonPawnKey[BLACK] = GenerateNonPawnKey(this, BLACK);
     ASSERT(check());
 }
 
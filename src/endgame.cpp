@@ -0,0 +1,181 @@
+#include "alo/types.hpp"
+
+// Specialized evaluators for material sets the generic terms misjudge,
+// looked up once per material signature by the material table.
+// Evaluators score for the side to move; scaling functions return a factor
+// out of SCALE_NORMAL for the strong side.
+
+// Well above any normal evaluation but clear of mate scores
+#define KNOWN_WIN 10000
+
+// a1 is dark
+#define DARK_SQUARES 0xAA55AA55AA55AA55ULL
+
+typedef struct {
+    U64 key;
+    EndgameFn fn;
+} S_ENDGAME;
+
+typedef struct {
+    U64 key;
+    ScaleFn fn;
+    int strong;
+} S_SCALING;
+
+static S_ENDGAME Endgames[8];
+static int EndgameCount = 0;
+static S_SCALING Scalings[8];
+static int ScalingCount = 0;
+
+// Grows toward the edges and corners, where a lone king gets mated
+static inline int PushToEdge(const int sq) {
+    const int f = sq % 8 < 4 ? 3 - sq % 8 : sq % 8 - 4;
+    const int r = sq / 8 < 4 ? 3 - sq / 8 : sq / 8 - 4;
+    return 20 * (f + r) + 10;
+}
+
+static inline int PushClose(const int sq1, const int sq2) {
+    return 140 - 20 * SqDistance(sq1, sq2);
+}
+
+static inline int NonPawnMaterial(const Board *pos, const int col) {
+    const int pawn = col == WHITE ? wP : bP;
+    return pos->material[col] - PieceVal[wK] - pos->pceNum[pawn] * PieceVal[pawn];
+}
+
+static inline int StrongSide(const Board *pos) {
+    return pos->material[WHITE] >= pos->material[BLACK] ? WHITE : BLACK;
+}
+
+// Material code such as "KBNK": the strong side's pieces, then the weak side's
+static U64 MaterialKeyOf(const char *code, const int strong) {
+    int count[13] = {0};
+    int col = strong;
+    U64 key = 0ULL;
+    for(int index = 0; code[index]; ++index) {
+        if(index > 0 && code[index] == 'K') {
+            col ^= 1;
+        }
+        int pce = EMPTY;
+        for(int p = wP; p <= wK; ++p) {
+            if(PceChar[p] == code[index]) pce = p;
+        }
+        ASSERT(pce != EMPTY);
+        if(col == BLACK) pce += bP - wP;
+        key ^= PieceKeys[pce][count[pce]++];
+    }
+    return key;
+}
+
+// Enough material against a bare king: drive it to the edge and bring the
+// king closer. Known wins get a bonus so the search converts instead of
+// hoarding material.
+static int EvaluateKXK(const Board *pos) {
+    const int strong = StrongSide(pos);
+    const int weak = strong ^ 1;
+    const int strongK = SQ64(pos->kingSq[strong]);
+    const int weakK = SQ64(pos->kingSq[weak]);
+    const int pawn = strong == WHITE ? wP : bP;
+
+    int score = pos->material[strong] - PieceVal[wK] + PushToEdge(weakK) + PushClose(strongK, weakK);
+    // Two bishops mate only if they run on different colours
+    const U64 bishops = pos->pceBB[pawn + 2];
+    const int bishopPair = (bishops & DARK_SQUARES) && (bishops & ~DARK_SQUARES);
+    if(pos->pceNum[pawn + 4] || pos->pceNum[pawn + 3] || (pos->pceNum[pawn + 1] && bishops) || bishopPair) {
+        score += KNOWN_WIN;
+    }
+    return pos->side == strong ? score : -score;
+}
+
+// Mate is only possible in a corner of the bishop's colour
+static int EvaluateKBNK(const Board *pos) {
+    const int strong = StrongSide(pos);
+    const int weak = strong ^ 1;
+    const int strongK = SQ64(pos->kingSq[strong]);
+    int weakK = SQ64(pos->kingSq[weak]);
+    U64 bishop = pos->pceBB[strong == WHITE ? wB : bB];
+    const int bsq = POP(&bishop);
+
+    // Mirror so the target corners are always a1 and h8 (dark squares)
+    if(((bsq % 8) + (bsq / 8)) % 2 == 1) {
+        weakK ^= 7;
+    }
+    const int toCorner = SqDistance(weakK, 0) < SqDistance(weakK, 63) ? SqDistance(weakK, 0) : SqDistance(weakK, 63);
+    int score = KNOWN_WIN + PieceVal[wB] + PieceVal[wN] + PushClose(strongK, SQ64(pos->kingSq[weak]));
+    score += PushToEdge(weakK) + 60 * (7 - toCorner);
+    return pos->side == strong ? score : -score;
+}
+
+// Bishop and rook pawns on one file: if the bishop cannot cover the
+// promotion square and the defending king holds the corner, it is a draw
+static int ScaleKBPsK(const Board *pos, const int strong) {
+    const int weak = strong ^ 1;
+    const U64 pawns = pos->pceBB[strong == WHITE ? wP : bP];
+    const int weakK = SQ64(pos->kingSq[weak]);
+    U64 bishop = pos->pceBB[strong == WHITE ? wB : bB];
+    const int bsq = POP(&bishop);
+
+    int file = FILE_NONE;
+    if(!(pawns & ~FileBBMask[FILE_A])) file = FILE_A;
+    else if(!(pawns & ~FileBBMask[FILE_H])) file = FILE_H;
+    if(file == FILE_NONE) {
+        return SCALE_NORMAL;
+    }
+    const int queening = strong == WHITE ? 56 + file : file;
+    const int bishopDark = ((bsq % 8) + (bsq / 8)) % 2 == 0;
+    const int queeningDark = ((queening % 8) + (queening / 8)) % 2 == 0;
+    if(bishopDark != queeningDark && SqDistance(weakK, queening) <= 1) {
+        return 0;
+    }
+    return SCALE_NORMAL;
+}
+
+static void AddEndgame(const char *code, EndgameFn fn) {
+    for(int strong = WHITE; strong <= BLACK; ++strong) {
+        ASSERT(EndgameCount < 8);
+        Endgames[EndgameCount].key = MaterialKeyOf(code, strong);
+        Endgames[EndgameCount++].fn = fn;
+    }
+}
+
+static void AddScaling(const char *code, ScaleFn fn) {
+    for(int strong = WHITE; strong <= BLACK; ++strong) {
+        ASSERT(ScalingCount < 8);
+        Scalings[ScalingCount].key = MaterialKeyOf(code, strong);
+        Scalings[ScalingCount].fn = fn;
+        Scalings[ScalingCount++].strong = strong;
+    }
+}
+
+void InitEndgames() {
+    EndgameCount = 0;
+    ScalingCount = 0;
+    AddEndgame("KBNK", EvaluateKBNK);
+    AddScaling("KBPK", ScaleKBPsK);
+    AddScaling("KBPPK", ScaleKBPsK);
+    AddScaling("KBPPPK", ScaleKBPsK);
+}
+
+EndgameFn FindEndgame(const Board *pos) {
+    for(int index = 0; index < EndgameCount; ++index) {
+        if(Endgames[index].key == pos->materialKey) {
+            return Endgames[index].fn;
+        }
+    }
+    // Any bare king facing at least a rook's worth of pieces
+    for(int col = WHITE; col <= BLACK; ++col) {
+        if(pos->material[col ^ 1] == PieceVal[wK] && NonPawnMaterial(pos, col) >= PieceVal[wR]) {
+            return EvaluateKXK;
+        }
+    }
+    return NULL;
+}
+
+ScaleFn FindScaling(const Board *pos, const int strong) {
+    for(int index = 0; index < ScalingCount; ++index) {
+        if(Scalings[index].key == pos->materialKey && Scalings[index].strong == strong) {
+            return Scalings[index].fn;
+        }
+    }
+    return NULL;
+}
@@ -17,6 +17,21 @@ const int QueenSemiOpenFile = 3;
 const int RookFileDoubled = 10;
 const int BishopDoubled = 30;
 const int PawnShieldBonus = 20;
+const int pawnDoubled = -10;
+const int pawnBackward = -8;
+// Per square reached outside own pieces and enemy pawn attacks
+const int KnightMobility = 4;
+const int BishopMobility = 4;
+const int RookMobility = 2;
+const int QueenMobility = 1;
+// Endgame, per king step from a passed pawn's stop square, times its rank
+const int PassedKingTheirs = 3;
+const int PassedKingOwn = 2;
+// Per square next to the king that the enemy attacks, while it has a queen
+const int KingZoneAttacked = 6;
+const int KingZoneAttackedTwice = 4;
+// Largest swing expected from the terms lazy evaluation skips
+const int LazyMargin = 400;
 
 // Forward declarations for tables defined below
 extern const int PawnTable[64];
@@ -30,93 +45,308 @@ int MaterialDraw(const Board *pos);
 int kingSafety(Board *pos, int roi);
 
 #define MIRROR64(sq) (Mirror64[(sq)])
-#define ENDGAME_MAT (1 * PieceVal[wR] + 2 * PieceVal[wN] + 2 * PieceVal[wP] + PieceVal[wK])
 
 static bool NNUE = false;
 
-int alo::Evaluator::evaluate(Board *pos) {
-    if (NNUE) {
-        return NNUE_Evaluate(pos);
+// Mobility and king-zone pressure of one side, from its attack map
+static int attackTerms(const Board *pos, const S_ATTACKS *attacks, const int col) {
+    const int them = col ^ 1;
+    const int pawn = col == WHITE ? wP : bP;
+    int score = 0;
+
+    score += KnightMobility * attacks->mobility[pawn + 1];
+    score += BishopMobility * attacks->mobility[pawn + 2];
+    score += RookMobility * attacks->mobility[pawn + 3];
+    score += QueenMobility * attacks->mobility[pawn + 4];
+
+    if(pos->pceNum[them == WHITE ? wQ : bQ]) {
+        const int ksq = SQ64(pos->kingSq[col]);
+        const U64 zone = KingAttacks[ksq] | SetMask[ksq];
+        score -= KingZoneAttacked * CNT(zone & attacks->all[them]);
+        score -= KingZoneAttackedTwice * CNT(zone & attacks->twice[them]);
     }
-    int pce;
-    int pceNum;
-    int sq;
-    int score = pos->material[WHITE] - pos->material[BLACK];
+    return score;
+}
 
-    // Insufficient material draw
-    if(!pos->pceNum[wP] && !pos->pceNum[bP] && MaterialDraw(pos) == TRUE) {
-        return 0;
+// Isolated, doubled, backward and passed pawns of both sides, white-relative.
+// Passed pawns are worth more in the endgame, so the midgame gets half.
+static void evaluatePawns(const Board *pos, S_PAWNENTRY *entry) {
+    const U64 pawns[2] = { pos->pceBB[wP], pos->pceBB[bP] };
+    int mg = 0;
+    int eg = 0;
+
+    entry->key = pos->pawnKey;
+    entry->passed = 0ULL;
+    for(int col = WHITE; col <= BLACK; ++col) {
+        const int sign = col == WHITE ? 1 : -1;
+        const U64 own = pawns[col];
+        const U64 their = pawns[col ^ 1];
+        U64 bb = own;
+        while(bb) {
+            const int sq = POP(&bb);
+            const int file = sq % 8;
+            const int relRank = col == WHITE ? sq / 8 : 7 - sq / 8;
+            const U64 front = col == WHITE ? WhitePassedMask[sq] : BlackPassedMask[sq];
+            const int stop = col == WHITE ? sq + 8 : sq - 8;
+            int term = 0;
+
+            if(front & FileBBMask[file] & own) {
+                term += pawnDoubled;
+            }
+            if(!(IsolatedMask[sq] & own)) {
+                term += pawnIsolated;
+            } else {
+                // No neighbour level or behind to support it, and the
+                // stop square is held by an enemy pawn
+                const U64 support = IsolatedMask[sq] & (col == WHITE ? BlackPassedMask[stop] : WhitePassedMask[stop]);
+                if(!(support & own) && (PawnAttacks[col][stop] & their)) {
+                    term += pawnBackward;
+                }
+            }
+            mg += sign * term;
+            eg += sign * term;
+
+            // Only the front pawn of a doubled passer is passed
+            if(!(front & their) && !(front & FileBBMask[file] & own)) {
+                entry->passed |= SetMask[sq];
+                mg += sign * pawnPassed[relRank] / 2;
+                eg += sign * pawnPassed[relRank];
+            }
+        }
     }
-    // Fifty-move rule
-    if(pos->fiftyMove >= 100) {
-        return 0;
+    entry->score[MG] = (short)mg;
+    entry->score[EG] = (short)eg;
+}
+
+// Kings near the stop squares of the side's passed pawns; depends on the
+// king squares, so it is worked out from the cached passed set every time
+static int passedPawnKings(const Board *pos, const U64 passed, const int col) {
+    const int ownK = SQ64(pos->kingSq[col]);
+    const int theirK = SQ64(pos->kingSq[col ^ 1]);
+    U64 bb = passed & pos->pceBB[col == WHITE ? wP : bP];
+    int score = 0;
+    while(bb) {
+        const int sq = POP(&bb);
+        const int relRank = col == WHITE ? sq / 8 : 7 - sq / 8;
+        const int stop = col == WHITE ? sq + 8 : sq - 8;
+        score += relRank * (PassedKingTheirs * SqDistance(theirK, stop) - PassedKingOwn * SqDistance(ownK, stop));
     }
-    // Threefold repetitions
-    if(IsRepetition(pos)) {
+    return score;
+}
+
+// Pawns directly in front of the king; depends on the king square, so it is
+// not part of the cached pawn entry
+static int pawnShield(const Board *pos, const int col) {
+    const int ksq = SQ64(pos->kingSq[col]);
+    const U64 front = col == WHITE ? WhitePassedMask[ksq] : BlackPassedMask[ksq];
+    return PawnShieldBonus * CNT(PawnShield[ksq] & front & pos->pceBB[col == WHITE ? wP : bP]);
+}
+
+// A side without pawns wins nothing with less than a rook, and little while
+// less than a rook up, unless it holds a queen the other side cannot match
+static int materialScale(const Board *pos, const int col) {
+    const int pawn = col == WHITE ? wP : bP;
+    const int theirPawn = col == WHITE ? bP : wP;
+    if(pos->pceNum[pawn]) {
+        return SCALE_NORMAL;
+    }
+    const int own = pos->material[col] - PieceVal[wK];
+    const int their = pos->material[col ^ 1] - PieceVal[wK] - pos->pceNum[theirPawn] * PieceVal[theirPawn];
+    if(own < PieceVal[wR]) {
         return 0;
     }
+    if(pos->pceNum[pawn + 4] && !pos->pceNum[theirPawn + 4]) {
+        return SCALE_NORMAL;
+    }
+    return own - their < PieceVal[wR] ? SCALE_NORMAL / 4 : SCALE_NORMAL;
+}
 
-    pce = wP;
-    for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
-        sq = pos->plist[pce][pceNum];
-        score += PawnTable[SQ64(sq)];
+static void evaluateMaterial(const Board *pos, S_MATERIALENTRY *entry) {
+    entry->key = pos->materialKey;
+    entry->endgame = FindEndgame(pos);
+    entry->scaling[WHITE] = FindScaling(pos, WHITE);
+    entry->scaling[BLACK] = FindScaling(pos, BLACK);
+    entry->draw = !pos->pceNum[wP] && !pos->pceNum[bP] && MaterialDraw(pos) == TRUE;
+    entry->imbalance = (short)((pos->pceNum[wB] >= 2 ? BishopDoubled : 0) - (pos->pceNum[bB] >= 2 ? BishopDoubled : 0));
+    entry->scale[WHITE] = (unsigned char)materialScale(pos, WHITE);
+    entry->scale[BLACK] = (unsigned char)materialScale(pos, BLACK);
+}
+
+void ClearEvalTables(S_EVALTABLES *tables) {
+    for(int index = 0; index < PAWN_TABLE_SIZE; ++index) {
+        tables->pawns[index].key = 0ULL;
+        tables->pawns[index].passed = 0ULL;
+        tables->pawns[index].score[MG] = tables->pawns[index].score[EG] = 0;
+    }
+    for(int index = 0; index < MATERIAL_TABLE_SIZE; ++index) {
+        tables->material[index].key = 0ULL;
+        tables->material[index].endgame = NULL;
+        tables->material[index].scaling[WHITE] = NULL;
+        tables->material[index].scaling[BLACK] = NULL;
+    }
+    for(int index = 0; index < MAX_DEPTH; ++index) {
+        tables->attacksKey[index] = 0ULL;
     }
-    pce = bP;
-    for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
-        sq = pos->plist[pce][pceNum];
-        score -= PawnTable[MIRROR64(SQ64(sq))];
+}
+
+// Direct-mapped posKey -> score cache shared by every evaluation, sized on
+// its own rather than with Hash. The key's upper bits and the score share
+// one word, so there is nothing to lock and a slot holding another position
+// reads as a miss. Scores depend only on the position, so entries never
+// need clearing.
+#define EVAL_CACHE_SIZE 65536
+#define EVAL_CACHE_KEYMASK (~0xFFFFULL)
+static U64 EvalCache[EVAL_CACHE_SIZE];
+
+static inline int probeEvalCache(const Board *pos, int *score) {
+    const U64 entry = EvalCache[pos->posKey & (EVAL_CACHE_SIZE - 1)];
+    if((entry ^ pos->posKey) & EVAL_CACHE_KEYMASK) {
+        return FALSE;
     }
+    *score = (short)(entry & 0xFFFF);
+    return TRUE;
+}
 
-    pce = wN;
-    for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
-        sq = pos->plist[pce][pceNum];
-        score += KnightTable[SQ64(sq)];
+static inline void storeEvalCache(const Board *pos, const int score) {
+    EvalCache[pos->posKey & (EVAL_CACHE_SIZE - 1)] = (pos->posKey & EVAL_CACHE_KEYMASK) | (U64)(unsigned short)score;
+}
+
+static S_MATERIALENTRY *probeMaterial(const Board *pos, S_EVALTABLES *tables, S_MATERIALENTRY *local) {
+    S_MATERIALENTRY *material = local;
+    if(tables) {
+        material = &tables->material[pos->materialKey & (MATERIAL_TABLE_SIZE - 1)];
     }
-    pce = bN;
-    for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
-        sq = pos->plist[pce][pceNum];
-        score -= KnightTable[MIRROR64(SQ64(sq))];
+    if(!tables || material->key != pos->materialKey) {
+        evaluateMaterial(pos, material);
     }
+    return material;
+}
 
-    pce = wB;
-    for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
-        sq = pos->plist[pce][pceNum];
-        score += BishopTable[SQ64(sq)];
+static S_PAWNENTRY *probePawns(const Board *pos, S_EVALTABLES *tables, S_PAWNENTRY *local) {
+    S_PAWNENTRY *pawns = local;
+    if(tables) {
+        pawns = &tables->pawns[pos->pawnKey & (PAWN_TABLE_SIZE - 1)];
     }
-    pce = bB;
-    for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
-        sq = pos->plist[pce][pceNum];
-        score -= BishopTable[MIRROR64(SQ64(sq))];
+    if(!tables || pawns->key != pos->pawnKey) {
+        evaluatePawns(pos, pawns);
     }
+    return pawns;
+}
 
-    pce = wR;
-    for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
-        sq = pos->plist[pce][pceNum];
-        score += RookTable[SQ64(sq)];
+static inline int taper(const Board *pos, const int mg, const int eg) {
+    const int phase = pos->phase < PHASE_MAX ? pos->phase : PHASE_MAX;
+    return (mg * phase + eg * (PHASE_MAX - phase)) / PHASE_MAX;
+}
+
+static inline int scaled(const Board *pos, const S_MATERIALENTRY *material, const int score) {
+    const int leader = score > 0 ? WHITE : BLACK;
+    const int scale = material->scaling[leader] ? material->scaling[leader](pos, leader) : material->scale[leader];
+    return scale == SCALE_NORMAL ? score : score * scale / SCALE_NORMAL;
+}
+
+// Material, imbalance and the incremental piece-square sums bound the score
+// to within LazyMargin. When that is already outside the window, return it
+// and skip everything else.
+static int lazyExit(const Board *pos, S_EVALTABLES *tables, const int alpha, const int beta, int *score) {
+    if(alpha <= -SCORE_INF && beta >= SCORE_INF) {
+        return FALSE;
+    }
+    S_MATERIALENTRY localMaterial[1];
+    const S_MATERIALENTRY *material = probeMaterial(pos, tables, localMaterial);
+    if(material->draw || material->endgame) {
+        return FALSE;
+    }
+    int cheap = pos->material[WHITE] - pos->material[BLACK] + material->imbalance + taper(pos, pos->psq[MG], pos->psq[EG]);
+    cheap = scaled(pos, material, cheap);
+    if(pos->side == BLACK) {
+        cheap = -cheap;
+    }
+    if(cheap - LazyMargin >= beta || cheap + LazyMargin <= alpha) {
+        *score = cheap;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static int evaluateHce(Board *pos, S_EVALTABLES *tables);
+
+int alo::Evaluator::evaluate(Board *pos) {
+    return evaluate(pos, NULL, -SCORE_INF, SCORE_INF);
+}
+
+// Lazy results are bounds rather than scores, so only full ones are cached
+int alo::Evaluator::evaluate(Board *pos, S_EVALTABLES *tables, int alpha, int beta) {
+    int score;
+    // Fifty-move rule; posKey does not see the counter
+    if(pos->fiftyMove >= 100) {
+        return 0;
     }
-    pce = bR;
-    for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) {
-        sq = pos->plist[pce][pceNum];
-        score -= RookTable[MIRROR64(SQ64(sq))];
+    if(probeEvalCache(pos, &score)) {
+        return score;
     }
+    if(lazyExit(pos, tables, alpha, beta, &score)) {
+        return score;
+    }
+    score = NNUE ? NNUE_Evaluate(pos) : evaluateHce(pos, tables);
+    storeEvalCache(pos, score);
+    return score;
+}
+
+// Hand-crafted evaluation for the side to move
+static int evaluateHce(Board *pos, S_EVALTABLES *tables) {
+    S_MATERIALENTRY localMaterial[1];
+    const S_MATERIALENTRY *material = probeMaterial(pos, tables, localMaterial);
+    // Insufficient material draw
+    if(material->draw) {
+        return 0;
+    }
+    if(material->endgame) {
+        return material->endgame(pos);
+    }
+
+    int score = pos->material[WHITE] - pos->material[BLACK] + material->imbalance;
 
-    pce = wQ; // currently no PST for queens
-    for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) { (void)pos->plist[pce][pceNum]; }
-    pce = bQ;
-    for(pceNum = 0; pceNum < pos->pceNum[pce]; ++pceNum) { (void)pos->plist[pce][pceNum]; }
+    // Piece-square sums are kept by MakeMove; only the taper is done here
+    S_PAWNENTRY localPawns[1];
+    const S_PAWNENTRY *pawns = probePawns(pos, tables, localPawns);
+    const int mg = pos->psq[MG] + pawns->score[MG] + pawnShield(pos, WHITE) - pawnShield(pos, BLACK);
+    const int eg = pos->psq[EG] + pawns->score[EG]
+                 + passedPawnKings(pos, pawns->passed, WHITE) - passedPawnKings(pos, pawns->passed, BLACK);
+    score += taper(pos, mg, eg);
 
-    pce = wK;
-    sq = pos->plist[pce][0];
-    if(pos->material[WHITE] < ENDGAME_MAT) score += KingE[SQ64(sq)]; else score += KingO[SQ64(sq)];
-    pce = bK;
-    sq = pos->plist[pce][0];
-    if(pos->material[BLACK] < ENDGAME_MAT) score -= KingE[MIRROR64(SQ64(sq))]; else score -= KingO[MIRROR64(SQ64(sq))];
+    S_ATTACKS localAttacks[1];
+    const S_ATTACKS *attacks = GetAttacks(pos, tables, localAttacks);
+    score += attackTerms(pos, attacks, WHITE) - attackTerms(pos, attacks, BLACK);
 
+    score = scaled(pos, material, score);
     return (pos->side == WHITE) ? score : -score;
 }
 
+// Midgame and endgame piece-square values, white-relative: black entries are
+// mirrored and negated so one sum covers both sides. Queens have no table.
+int PsqTable[2][13][64];
+
+void InitPsqTables() {
+    const int *mg[7] = { NULL, PawnTable, KnightTable, BishopTable, RookTable, NULL, KingO };
+    const int *eg[7] = { NULL, PawnTable, KnightTable, BishopTable, RookTable, NULL, KingE };
+    for(int pce = wP; pce <= wK; ++pce) {
+        for(int sq = 0; sq < 64; ++sq) {
+            const int m = mg[pce] ? mg[pce][sq] : 0;
+            const int e = eg[pce] ? eg[pce][sq] : 0;
+            PsqTable[MG][pce][sq] = m;
+            PsqTable[EG][pce][sq] = e;
+            PsqTable[MG][pce + bP - wP][MIRROR64(sq)] = -m;
+            PsqTable[EG][pce + bP - wP][MIRROR64(sq)] = -e;
+        }
+    }
+}
+
 int EvaluatePosition(Board *pos) { return alo::Evaluator::evaluate(pos); }
 
+int EvaluateInWindow(Board *pos, S_EVALTABLES *tables, int alpha, int beta) {
+    return alo::Evaluator::evaluate(pos, tables, alpha, beta);
+}
+
 int MaterialDraw(const Board *pos) {
     if (!pos->pceNum[wR] && !pos->pceNum[bR] && !pos->pceNum[wQ] && !pos->pceNum[bQ]) {
 	  if (!pos->pceNum[bB] && !pos->pceNum[wB]) {
@@ -138,8 +368,6 @@ int MaterialDraw(const Board *pos) {
   return FALSE;
 }
 
-// Use IsRepetition from search.cpp for repetition detection
-
 const int PawnTable[64] = {
     0,  0,   0,   0,   0,   0,   0,   0,
     10, 10,  0,  -10, -10,  10,   15,  20,
@@ -22,3 +22,54 @@
     finalKey ^= CastleKeys[pos->castlePerm];
     return finalKey;
  }
+
+U64 GeneratePawnKey(const Board *pos) {
+    U64 finalKey = 0;
+    for(int pce = wP; pce <= bK; ++pce) {
+        if(!PiecePawn[pce]) continue;
+        U64 bb = pos->pceBB[pce];
+        while(bb) {
+            finalKey ^= PieceKeys[pce][SQ120(POP(&bb))];
+        }
+    }
+    return finalKey;
+}
+
+// One key per piece present, indexed by how many of that piece came before
+// it. Indices below 21 are off-board squares, which the position key never uses.
+U64 GenerateMaterialKey(const Board *pos) {
+    U64 finalKey = 0;
+    for(int pce = wP; pce <= bK; ++pce) {
+        for(int count = 0; count < pos->pceNum[pce]; ++count) {
+            finalKey ^= PieceKeys[pce][count];
+        }
+    }
+    return finalKey;
+}
+
+U64 GenerateNonPawnKey(const Board *pos, int col) {
+    U64 finalKey = 0;
+    for(int pce = wP; pce <= bK; ++pce) {
+        if(PiecePawn[pce] || PieceCol[pce] != col) continue;
+        U64 bb = pos->pceBB[pce];
+        while(bb) {
+            finalKey ^= PieceKeys[pce][SQ120(POP(&bb))];
+        }
+    }
+    return finalKey;
+}
+
+// Digest of every Zobrist key, so persisted tables can detect keys from another build.
+U64 HashKeyFingerprint() {
+    U64 h = 0xcbf29ce484222325ULL;
+    for(int pce = 0; pce < 13; ++pce) {
+        for(int sq = 0; sq < BOARD_SIZE; ++sq) {
+            h = (h ^ PieceKeys[pce][sq]) * 0x100000001b3ULL;
+        }
+    }
+    h = (h ^ SideKey) * 0x100000001b3ULL;
+    for(int index = 0; index < 16; ++index) {
+        h = (h ^ CastleKeys[index]) * 0x100000001b3ULL;
+    }
+    return h;
+}
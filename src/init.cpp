@@ -2,192 +2,228 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-int Sq120ToSq64[BOARD_SIZE];
-int Sq64ToSq120[64];
-
-#define RAND_64 ((U64)rand() | \
-    ((U64)rand() << 15) | \
-    ((U64)rand() << 30) | \
-    ((U64)rand() << 45) | \
-    (((U64)rand() & 0xf) << 60))
-
-U64 SetMask[64];
-U64 ClearMask[64];
-
-U64 PieceKeys[13][120];
-U64 SideKey;
-U64 CastleKeys[16];
-
-int FilesBrd[BOARD_SIZE];
-int RanksBrd[BOARD_SIZE];
-
-U64 FileBBMask[8];
-U64 RankBBMask[8];
-U64 BlackPassedMask[64];
-U64 WhitePassedMask[64];
-U64 IsolatedMask[64];
-
-U64 PawnShield[64];
-
-void InitEvalMask() {
-    int sq, tsq, r, f;
-
-    for(sq = 0; sq < 8; ++sq) {
-        FileBBMask[sq] = 0ULL;
-        RankBBMask[sq] = 0ULL;
-    }
-
-    for(r = RANK_8; r >= RANK_1; --r) {
-        for(f = FILE_A; f <= FILE_H; ++f) {
-            sq = FR2SQ(f, r);
-            tsq = SQ64(sq);
-            FileBBMask[f] |= (1ULL << tsq);
-            RankBBMask[r] |= (1ULL << tsq);
-        }
-    }
+U64 CuckooKeys[CUCKOO_SIZE];
+unsigned short CuckooMoves[CUCKOO_SIZE];
+
+U64 KnightAttacks[64];
+U64 KingAttacks[64];
+U64 PawnAttacks[2][64];
+U64 RayMasks[8][64];
+U64 BetweenBB[64][64];
+U64 LineBB[64][64];
+S_MAGIC BishopMagics[64];
+S_MAGIC RookMagics[64];
+
+// Every blocker subset of every square, 2^bits entries per square
+static U64 BishopTable[5248];
+static U64 RookTable[102400];
+
+// File and rank steps matching the NORTH..SOUTHWEST ray order
+static const int RayStep[8][2] = {
+    { 0, 1 }, { 1, 0 }, { 1, 1 }, { -1, 1 }, { 0, -1 }, { -1, 0 }, { 1, -1 }, { -1, -1 }
+};
+static const int KnightStep[8][2] = {
+    { 1, 2 }, { 2, 1 }, { 2, -1 }, { 1, -2 }, { -1, -2 }, { -2, -1 }, { -2, 1 }, { -1, 2 }
+};
+
+static U64 StepMask(int file, int rank) {
+    if(file < FILE_A || file > FILE_H || rank < RANK_1 || rank > RANK_8) return 0ULL;
+    return 1ULL << (rank * 8 + file);
+}
 
-    for(sq = 0; sq < 64; ++sq) {
-        IsolatedMask[sq] = 0ULL;
-        WhitePassedMask[sq] = 0ULL;
-        BlackPassedMask[sq] = 0ULL;
-    }
+void InitAttackMasks() {
+    int sq, dir, index, file, rank, f, r;
 
     for(sq = 0; sq < 64; ++sq) {
-        tsq = sq + 8;
-        while(tsq < 64) {
-            WhitePassedMask[sq] |= (1ULL << tsq);
-            tsq += 8;
-        }
-        tsq = sq - 8;
-        while(tsq >= 0) {
-            BlackPassedMask[sq] |= (1ULL << tsq);
-            tsq -= 8;
-        }
-        if(FilesBrd[SQ120(sq)] > FILE_A) {
-            IsolatedMask[sq] |= FileBBMask[FilesBrd[SQ120(sq)] - 1];
-            tsq = sq + 7;
-            while(tsq < 64) {
-                WhitePassedMask[sq] |= (1ULL << tsq);
-                tsq += 8;
-            }
-            tsq = sq - 9;
-            while(tsq >= 0) {
-                BlackPassedMask[sq] |= (1ULL << tsq);
-                tsq -= 8;
-            }
+        file = sq % 8;
+        rank = sq / 8;
+
+        KnightAttacks[sq] = 0ULL;
+        KingAttacks[sq] = 0ULL;
+        for(index = 0; index < 8; ++index) {
+            KnightAttacks[sq] |= StepMask(file + KnightStep[index][0], rank + KnightStep[index][1]);
+            KingAttacks[sq] |= StepMask(file + RayStep[index][0], rank + RayStep[index][1]);
         }
 
-        if(FilesBrd[SQ120(sq)] < FILE_H) {
-            IsolatedMask[sq] |= FileBBMask[FilesBrd[SQ120(sq)] + 1];
-
-            tsq = sq + 9;
-            while(tsq < 64) {
-                WhitePassedMask[sq] |= (1ULL << tsq);
-                tsq += 8;
-            }
-
-            tsq = sq - 7;
-            while(tsq >= 0) {
-                BlackPassedMask[sq] |= (1ULL << tsq);
-                tsq -= 8;
+        PawnAttacks[WHITE][sq] = StepMask(file - 1, rank + 1) | StepMask(file + 1, rank + 1);
+        PawnAttacks[BLACK][sq] = StepMask(file - 1, rank - 1) | StepMask(file + 1, rank - 1);
+
+        for(dir = NORTH; dir <= SOUTHWEST; ++dir) {
+            RayMasks[dir][sq] = 0ULL;
+            f = file + RayStep[dir][0];
+            r = rank + RayStep[dir][1];
+            while(StepMask(f, r)) {
+                RayMasks[dir][sq] |= StepMask(f, r);
+                f += RayStep[dir][0];
+                r += RayStep[dir][1];
             }
         }
     }
-    //Init pawn shield tables
+
+    // Squares strictly between two aligned squares, and the full line through them
+    int sq2, back;
     for(sq = 0; sq < 64; ++sq) {
-        U64 temp = 0xFFFFFFFFFFFFFFFFULL;
-        if(FilesBrd[SQ120(sq)] == FILE_A) {
-            temp &= (FileBBMask[FILE_B] | FileBBMask[FILE_A]);
-        } else if(FilesBrd[SQ120(sq)] == FILE_H) {
-            temp &= (FileBBMask[FILE_G] | FileBBMask[FILE_H]);
-        } else {
-            temp &= (FileBBMask[FilesBrd[SQ120(sq)] - 1] | FileBBMask[FilesBrd[SQ120(sq)]] | FileBBMask[FilesBrd[SQ120(sq)] + 1]);
+        for(sq2 = 0; sq2 < 64; ++sq2) {
+            BetweenBB[sq][sq2] = 0ULL;
+            LineBB[sq][sq2] = 0ULL;
         }
-        if(RanksBrd[SQ120(sq)] == RANK_1) {
-            temp &= (RankBBMask[RANK_2] | RankBBMask[RANK_1]);
-        } else if(RanksBrd[SQ120(sq)] == RANK_8) {
-            temp &= (RankBBMask[RANK_7] | RankBBMask[RANK_8]);
-        } else {
-            temp &= (RankBBMask[RanksBrd[SQ120(sq)] - 1] | RankBBMask[RanksBrd[SQ120(sq)]] | RankBBMask[RanksBrd[SQ120(sq)] + 1]);
+        for(dir = NORTH; dir <= SOUTHWEST; ++dir) {
+            for(back = NORTH; back <= SOUTHWEST; ++back) {
+                if(RayStep[back][0] == -RayStep[dir][0] && RayStep[back][1] == -RayStep[dir][1]) break;
+            }
+            U64 ray = RayMasks[dir][sq];
+            while(ray) {
+                sq2 = POP(&ray);
+                BetweenBB[sq][sq2] = RayMasks[dir][sq] & ~RayMasks[dir][sq2] & ~(1ULL << sq2);
+                LineBB[sq][sq2] = RayMasks[dir][sq] | RayMasks[back][sq] | (1ULL << sq);
+            }
         }
-        PawnShield[sq] = temp;
     }
 }
 
-void InitFilesRanksBrd() {
-    int index = 0;
-    int file = FILE_A;
-    int rank = RANK_1;
-    int sq = A1;
-    for(index = 0; index < BOARD_SIZE; ++index) {
-        FilesBrd[index] = OFFBOARD;
-        RanksBrd[index] = OFFBOARD;
-    }
-    for(rank = RANK_1; rank <= RANK_8; ++rank) {
-        for(file = FILE_A; file <= FILE_H; ++file) {
-            sq = FR2SQ(file, rank);
-            FilesBrd[sq] = file;
-            RanksBrd[sq] = rank;
+#define RANK_1_BB 0x00000000000000FFULL
+#define RANK_8_BB 0xFF00000000000000ULL
+#define FILE_A_BB 0x0101010101010101ULL
+#define FILE_H_BB 0x8080808080808080ULL
+
+static const int BishopDirs[4] = { NORTHEAST, NORTHWEST, SOUTHEAST, SOUTHWEST };
+static const int RookDirs[4] = { NORTH, EAST, SOUTH, WEST };
+
+// Reference slider attacks, only used to fill the tables. Rays toward higher
+// squares find their blocker with the lowest set bit, the others with the highest.
+static U64 SlideAttacks(const int sq, const U64 occ, const int *dirs) {
+    U64 attacks = 0ULL;
+    for(int index = 0; index < 4; ++index) {
+        int dir = dirs[index];
+        U64 ray = RayMasks[dir][sq];
+        U64 blockers = ray & occ;
+        if(blockers) {
+            int blocker = dir < SOUTH ? __builtin_ctzll(blockers) : 63 - __builtin_clzll(blockers);
+            ray ^= RayMasks[dir][blocker];
         }
+        attacks |= ray;
     }
+    return attacks;
 }
 
-void InitHashKeys() {
-    int index = 0;
-    int index2 = 0;
-    for(index = 0; index < 13; ++index) {
-        for(index2 = 0; index2 < 120; ++index2) {
-            PieceKeys[index][index2] = RAND_64;
-        }
-    }
-    SideKey = RAND_64;
-    for(index = 0; index < 16; ++index) {
-        CastleKeys[index] = RAND_64;
-    }
+#if !defined(__BMI2__)
+// Seeded xorshift so the magics come out the same on every start; one seed
+// per rank, chosen because they find every magic quickly
+static const U64 MagicSeeds[8] = { 728, 10316, 55013, 32803, 12281, 15100, 16645, 255 };
+static U64 MagicSeed;
+
+static U64 MagicRand() {
+    MagicSeed ^= MagicSeed >> 12;
+    MagicSeed ^= MagicSeed << 25;
+    MagicSeed ^= MagicSeed >> 27;
+    return MagicSeed * 0x2545F4914F6CDD1DULL;
 }
+#endif
 
-void InitBitMask() {
-    int index = 0;
+static void InitMagicTable(S_MAGIC *magics, U64 *table, const int *dirs) {
+    static U64 occupancy[4096], reference[4096];
+    int sq, size, index;
+    U64 offset = 0;
 
-    for(index = 0; index < 64; ++index) {
-        SetMask[index] = 0ULL;
-        ClearMask[index] = 0ULL;
+    for(sq = 0; sq < 64; ++sq) {
+        S_MAGIC *m = &magics[sq];
+        // Edge squares never block anything beyond themselves
+        U64 edges = ((RANK_1_BB | RANK_8_BB) & ~(RANK_1_BB << (8 * (sq / 8))))
+                  | ((FILE_A_BB | FILE_H_BB) & ~(FILE_A_BB << (sq % 8)));
+
+        m->mask = SlideAttacks(sq, 0ULL, dirs) & ~edges;
+        m->shift = 64 - CNT(m->mask);
+        m->magic = 0ULL;
+        m->attacks = table + offset;
+
+        // Carry-rippler walk over every subset of the mask
+        U64 b = 0ULL;
+        size = 0;
+        do {
+            occupancy[size] = b;
+            reference[size] = SlideAttacks(sq, b, dirs);
+            size++;
+            b = (b - m->mask) & m->mask;
+        } while(b);
+
+#if defined(__BMI2__)
+        for(index = 0; index < size; ++index) {
+            m->attacks[MAGIC_INDEX(m, occupancy[index])] = reference[index];
+        }
+#else
+        static int epoch[4096];
+        static int attempt = 0;
+        MagicSeed = MagicSeeds[sq / 8];
+        for(index = 0; index < size;) {
+            m->magic = MagicRand() & MagicRand() & MagicRand();
+            if(CNT((m->mask * m->magic) >> 56) < 6) continue;
+
+            // A clash is only allowed when both subsets share the same attacks
+            ++attempt;
+            for(index = 0; index < size; ++index) {
+                U64 idx = MAGIC_INDEX(m, occupancy[index]);
+                if(epoch[idx] < attempt) {
+                    epoch[idx] = attempt;
+                    m->attacks[idx] = reference[index];
+                } else if(m->attacks[idx] != reference[index]) {
+                    break;
+                }
+            }
+        }
+#endif
+        offset += size;
     }
+}
 
-    for(index = 0; index < 64; ++index) {
-        SetMask[index] |= (1ULL << index);
-        ClearMask[index] = ~SetMask[index];
-    }
+void InitSliderAttacks() {
+    InitMagicTable(BishopMagics, BishopTable, BishopDirs);
+    InitMagicTable(RookMagics, RookTable, RookDirs);
 }
 
-void InitSq120To64() {
+// Every reversible non-pawn move on an empty board, stored once for both
+// directions. Needs the hash keys and the slider attacks.
+void InitCuckoo() {
     int index = 0;
-    int file = FILE_A;
-    int rank = RANK_1;
-    int sq = A1;
-    int sq64 = 0;
-
-    for(index = 0; index < BOARD_SIZE; ++index) {
-        Sq120ToSq64[index] = 65;
+    for(index = 0; index < CUCKOO_SIZE; ++index) {
+        CuckooKeys[index] = 0ULL;
+        CuckooMoves[index] = NOMOVE;
     }
-    for(index = 0; index < 64; ++index) {
-        Sq64ToSq120[index] = 120;
-    }
-    for(rank = RANK_1; rank <= RANK_8; ++rank) {
-        for(file = FILE_A; file <= FILE_H; ++file) {
-            sq = FR2SQ(file, rank);
-            Sq64ToSq120[sq64] = sq;
-            Sq120ToSq64[sq] = sq64;
-            sq64++;
+    for(int pce = wN; pce <= bK; ++pce) {
+        if(PiecePawn[pce]) continue;
+        for(int sq = 0; sq < 64; ++sq) {
+            U64 targets = 0ULL;
+            if(PieceKnight[pce]) targets = KnightAttacks[sq];
+            else if(PieceKing[pce]) targets = KingAttacks[sq];
+            if(PieceBishopQueen[pce]) targets |= BishopAttacks(sq, 0ULL);
+            if(PieceRookQueen[pce]) targets |= RookAttacks(sq, 0ULL);
+            for(int sq2 = sq + 1; sq2 < 64; ++sq2) {
+                if(!(targets & (1ULL << sq2))) continue;
+                U64 key = PieceKeys[pce][SQ120(sq)] ^ PieceKeys[pce][SQ120(sq2)] ^ SideKey;
+                unsigned short move = (unsigned short)(sq | (sq2 << 6));
+                int slot = CUCKOO_H1(key);
+                int kicks = 0;
+                // Displace occupants between their two slots until one lands
+                // empty. A move left homeless only costs a missed cycle.
+                while(kicks++ < 64) {
+                    U64 tmpKey = CuckooKeys[slot];
+                    unsigned short tmpMove = CuckooMoves[slot];
+                    CuckooKeys[slot] = key;
+                    CuckooMoves[slot] = move;
+                    if(tmpMove == NOMOVE) break;
+                    key = tmpKey;
+                    move = tmpMove;
+                    slot = (slot == CUCKOO_H1(key)) ? CUCKOO_H2(key) : CUCKOO_H1(key);
+                }
+            }
         }
     }
 }
 
 void AllInit() {
-    InitFilesRanksBrd();
-    InitSq120To64();
-    InitBitMask();
-    InitHashKeys();
+    InitAttackMasks();
+    InitSliderAttacks();
+    InitCuckoo();
     InitMvvLva();
-    InitEvalMask();
+    InitPsqTables();
+    InitEndgames();
 }
@@ -18,7 +18,7 @@ char* Io::formatMove(const int move) {
         int rf = RanksBrd[FROMSQ(move)];
         int ft = FilesBrd[TOSQ(move)];
         int rt = RanksBrd[TOSQ(move)];
-        int promoted = PROMOTED(move);
+        int promoted = PROMOTED(move, WHITE);
         if(promoted) {
             char pchar = 'q';
             if(IsKn(promoted))       pchar = 'n';
@@ -45,9 +45,9 @@ int Io::parseMove(const char *ptrChar, Board *pos) {
         int Move = 0;
         int PromPce = EMPTY;
         for(MoveNum = 0; MoveNum < list->count; ++MoveNum) {
-            Move = list->moves[MoveNum].move;
+            Move = list->moves[MoveNum];
             if(FROMSQ(Move) == from && TOSQ(Move) == to) {
-                PromPce = PROMOTED(Move);
+                PromPce = PROMOTED(Move, pos->side);
                 if(PromPce != EMPTY) {
                     if(IsRQ(PromPce) && !IsBQ(PromPce) && ptrChar[4] == 'r') return Move;
                     else if(!IsRQ(PromPce) && IsBQ(PromPce) && ptrChar[4] == 'b') return Move;
@@ -64,8 +64,8 @@ int Io::parseMove(const char *ptrChar, Board *pos) {
 void Io::printMoveList(MoveList *list) {
         printf("MoveList:\n");
         for(int index = 0; index < list->count; ++index) {
-            int move = list->moves[index].move;
-            int score = list->moves[index].score;
+            int move = list->moves[index];
+            int score = list->scores[index];
             printf("Move:%d > %s (score:%d)\n", index+1, formatMove(move), score);
         }
         printf("MoveList Total %d Moves:\n\n", list->count);
@@ -73,9 +73,9 @@ void Io::printMoveList(MoveList *list) {
 
 void Io::printBin(int move) {
         printf("As binary:");
-        for(int index = 27; index >= 0; --index) {
+        for(int index = 15; index >= 0; --index) {
             if((1 << index) & move) printf("1"); else printf("0");
-            if(index != 26 && index % 4 == 0) printf(" ");
+            if(index != 0 && index % 4 == 0) printf(" ");
         }
 }
 } // namespace alo
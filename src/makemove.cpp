@@ -1,7 +1,7 @@
 #include "alo/types.hpp"
 #include <stdio.h>
 
-#define HASH_PCE(pce, sq) (pos->posKey ^= (PieceKeys[(pce)][(sq)]))
+#define HASH_PCE(pce, sq) HashPiece(pos, (pce), (sq))
 #define HASH_CA (pos->posKey ^= (CastleKeys[(pos->castlePerm)]))
 #define HASH_SIDE (pos->posKey ^= (SideKey))
 #define HASH_EP (pos->posKey ^= (PieceKeys[EMPTY][(pos->enPas)]))
@@ -21,19 +21,79 @@ const int CastlePerm[120] = {
     15, 15, 15, 15, 15, 15, 15, 15, 15, 15
 };
 
+// Key of the position reached by move, computed without touching the board.
+// Used to prefetch the child's hash entry before MakeMove.
+U64 KeyAfterMove(const Board *pos, const int move) {
+    int from = FROMSQ(move);
+    int to = TOSQ(move);
+    int pce = pos->pieces[from];
+    int captured = pos->pieces[to];
+    int promoted = PROMOTED(move, pos->side);
+    U64 key = pos->posKey ^ SideKey;
+
+    key ^= PieceKeys[pce][from];
+    key ^= PieceKeys[promoted != EMPTY ? promoted : pce][to];
+
+    if(captured != EMPTY) {
+        key ^= PieceKeys[captured][to];
+    }
+
+    if(ISEP(move)) {
+        if(pos->side == WHITE) {
+            key ^= PieceKeys[bP][to - 10];
+        } else {
+            key ^= PieceKeys[wP][to + 10];
+        }
+    } else if(ISCA(move)) {
+        switch(to) {
+            case C1: key ^= PieceKeys[wR][A1] ^ PieceKeys[wR][D1]; break;
+            case C8: key ^= PieceKeys[bR][A8] ^ PieceKeys[bR][D8]; break;
+            case G1: key ^= PieceKeys[wR][H1] ^ PieceKeys[wR][F1]; break;
+            case G8: key ^= PieceKeys[bR][H8] ^ PieceKeys[bR][F8]; break;
+            default: ASSERT(FALSE); break;
+        }
+    }
+
+    if(pos->enPas != NO_SQ) {
+        key ^= PieceKeys[EMPTY][pos->enPas];
+    }
+    if(ISPS(move)) {
+        key ^= PieceKeys[EMPTY][pos->side == WHITE ? from + 10 : from - 10];
+    }
+
+    key ^= CastleKeys[pos->castlePerm];
+    key ^= CastleKeys[pos->castlePerm & CastlePerm[from] & CastlePerm[to]];
+
+    return key;
+}
+
+// A piece's square key goes into the position key and into either the pawn
+// key or its colour's non-pawn key
+static inline void HashPiece(Board *pos, const int pce, const int sq) {
+    const U64 key = PieceKeys[pce][sq];
+    pos->posKey ^= key;
+    if(PiecePawn[pce]) {
+        pos->pawnKey ^= key;
+    } else {
+        pos->nonPawnKey[PieceCol[pce]] ^= key;
+    }
+}
+
 static void ClearPiece(const int sq, Board *pos) {
     ASSERT(SqOnBoard(sq));
     int pce = pos->pieces[sq];
     ASSERT(PieceValid(pce));
 
     int col = PieceCol[pce];
-    int index = 0;
-    int t_pceNum = -1;
+    int sq64 = SQ64(sq);
 
     HASH_PCE(pce, sq);
 
     pos->pieces[sq] = EMPTY;
     pos->material[col] -= PieceVal[pce];
+    pos->psq[MG] -= PsqTable[MG][pce][sq64];
+    pos->psq[EG] -= PsqTable[EG][pce][sq64];
+    pos->phase -= PiecePhase[pce];
 
     if(PieceBig[pce]) {
         pos->bigPce[col]--;
@@ -42,22 +102,15 @@ static void ClearPiece(const int sq, Board *pos) {
         } else {
             pos->minPce[col]--;
         }
-    } else {
-        CLRBIT(pos->pawns[col], SQ64(sq));
-        CLRBIT(pos->pawns[BOTH], SQ64(sq));
-    }
-
-    for(index = 0; index<pos->pceNum[pce]; ++index) {
-        if(pos->plist[pce][index] == sq) {
-            t_pceNum = index;
-            break;
-        }
     }
 
-    ASSERT(t_pceNum != -1);
+    ASSERT(pos->pceBB[pce] & SetMask[sq64]);
+    CLRBIT(pos->pceBB[pce], sq64);
+    CLRBIT(pos->occBB[col], sq64);
+    CLRBIT(pos->occBB[BOTH], sq64);
 
     pos->pceNum[pce]--;
-    pos->plist[pce][t_pceNum] = pos->plist[pce][pos->pceNum[pce]];
+    pos->materialKey ^= PieceKeys[pce][pos->pceNum[pce]];
 }
 
 static void AddPiece(const int sq, Board *pos, const int pce) {
@@ -65,6 +118,7 @@ static void AddPiece(const int sq, Board *pos, const int pce) {
     ASSERT(SqOnBoard(sq));
 
     int col = PieceCol[pce];
+    int sq64 = SQ64(sq);
 
     HASH_PCE(pce, sq);
 
@@ -77,51 +131,46 @@ static void AddPiece(const int sq, Board *pos, const int pce) {
         } else {
             pos->minPce[col]++;
         }
-    } else {
-        SETBIT(pos->pawns[col], SQ64(sq));
-        SETBIT(pos->pawns[BOTH], SQ64(sq));
     }
 
+    SETBIT(pos->pceBB[pce], sq64);
+    SETBIT(pos->occBB[col], sq64);
+    SETBIT(pos->occBB[BOTH], sq64);
+
     pos->material[col] += PieceVal[pce];
-    pos->plist[pce][pos->pceNum[pce]++] = sq;
+    pos->psq[MG] += PsqTable[MG][pce][sq64];
+    pos->psq[EG] += PsqTable[EG][pce][sq64];
+    pos->phase += PiecePhase[pce];
+    pos->materialKey ^= PieceKeys[pce][pos->pceNum[pce]];
+    pos->pceNum[pce]++;
 }
 
 static void MovePiece(const int from, const int to, Board *pos) {
     ASSERT(SqOnBoard(from));
     ASSERT(SqOnBoard(to));
 
-    int index = 0;
     int pce = pos->pieces[from];
     int col = PieceCol[pce];
-#ifdef DEBUG
-    int t_PieceNum = FALSE;
-#endif
+    U64 fromTo = SetMask[SQ64(from)] | SetMask[SQ64(to)];
+
     HASH_PCE(pce, from);
     pos->pieces[from] = EMPTY;
     
     HASH_PCE(pce, to);
     pos->pieces[to] = pce;
-    
-    if(!PieceBig[pce]) {
-        CLRBIT(pos->pawns[col], SQ64(from));
-        CLRBIT(pos->pawns[BOTH], SQ64(from));
-        SETBIT(pos->pawns[col], SQ64(to));
-        SETBIT(pos->pawns[BOTH], SQ64(to));
-    }
 
-    for(index = 0; index < pos->pceNum[pce]; ++index) {
-        if(pos->plist[pce][index] == from) {
-            pos->plist[pce][index] = to;
-#ifdef DEBUG
-            t_PieceNum = TRUE;
-#endif
-            break;
-        }
-    }
-    ASSERT(t_PieceNum);
+    pos->psq[MG] += PsqTable[MG][pce][SQ64(to)] - PsqTable[MG][pce][SQ64(from)];
+    pos->psq[EG] += PsqTable[EG][pce][SQ64(to)] - PsqTable[EG][pce][SQ64(from)];
+
+    ASSERT(pos->pceBB[pce] & SetMask[SQ64(from)]);
+    pos->pceBB[pce] ^= fromTo;
+    pos->occBB[col] ^= fromTo;
+    pos->occBB[BOTH] ^= fromTo;
 }
 
-int MakeMove(Board *pos, int move) {
+// The move must come from the legal generator; nothing is rejected here.
+// There is no undo: callers that need the old position keep a copy.
+void MakeMove(Board *pos, int move) {
     ASSERT(CheckBoard(pos));
 
     int from = FROMSQ(move);
@@ -133,15 +182,16 @@ int MakeMove(Board *pos, int move) {
     ASSERT(SideValid(side));
     ASSERT(PieceValid(pos->pieces[from]));
 
-    pos->history[pos->hisPly].posKey = pos->posKey;
+    // Read before the board changes; en passant captures off the target square
+    int captured = pos->pieces[to];
 
-    if(move & MFLAGEP) {
+    if(ISEP(move)) {
         if(side == WHITE) {
             ClearPiece(to-10, pos);
         } else {
             ClearPiece(to+10, pos);
         }
-    } else if(move & MFLAGCA) {
+    } else if(ISCA(move)) {
         switch(to) {
             case C1:
                 MovePiece(A1, D1, pos);
@@ -162,19 +212,14 @@ int MakeMove(Board *pos, int move) {
     if(pos->enPas != NO_SQ) HASH_EP;
     HASH_CA;
 
-    pos->history[pos->hisPly].move = move;
-    pos->history[pos->hisPly].fiftyMove = pos->fiftyMove;
-    pos->history[pos->hisPly].enPas = pos->enPas;
-    pos->history[pos->hisPly].castlePerm = pos->castlePerm;
-
     pos->castlePerm &= CastlePerm[from];
     pos->castlePerm &= CastlePerm[to];
     pos->enPas = NO_SQ;
 
     HASH_CA;
 
-    int captured = CAPTURED(move);
     pos->fiftyMove++;
+    pos->pliesFromNull++;
 
     if(captured != EMPTY) {
         ASSERT(PieceValid(captured));
@@ -187,7 +232,7 @@ int MakeMove(Board *pos, int move) {
 
     if(PiecePawn[pos->pieces[from]]) {
         pos->fiftyMove = 0;
-        if(move & MFLAGPS) {
+        if(ISPS(move)) {
             if(side == WHITE) {
                 pos->enPas = from + 10;
                 ASSERT(RanksBrd[pos->enPas] == RANK_3);
@@ -201,7 +246,7 @@ int MakeMove(Board *pos, int move) {
 
     MovePiece(from, to, pos);
 
-    int prPce = PROMOTED(move);
+    int prPce = PROMOTED(move, side);
 
     if(prPce != EMPTY) {
         ASSERT(PieceValid(prPce) && !PiecePawn[prPce]);
@@ -217,78 +262,7 @@ int MakeMove(Board *pos, int move) {
     HASH_SIDE;
 
     ASSERT(CheckBoard(pos));
-
-    if(SqAttacked(pos->kingSq[side], pos->side, pos)) {
-        TakeMove(pos);
-        return FALSE;
-    }
-
-    return TRUE;
-}
-
-void TakeMove(Board *pos) {
-    ASSERT(CheckBoard(pos));
-
-    pos->hisPly--;
-    pos->ply--;
-
-    int move = pos->history[pos->hisPly].move;
-    int from = FROMSQ(move);
-    int to = TOSQ(move);
-
-    ASSERT(SqOnBoard(from));
-    ASSERT(SqOnBoard(to));
-
-    if(pos->enPas != NO_SQ) HASH_EP;
-    HASH_CA;
-
-    pos->castlePerm = pos->history[pos->hisPly].castlePerm;
-    pos->fiftyMove = pos->history[pos->hisPly].fiftyMove;
-    pos->enPas = pos->history[pos->hisPly].enPas;
-
-    if(pos->enPas != NO_SQ) HASH_EP;
-    HASH_CA;
-
-    pos->side ^= 1;
-    HASH_SIDE;
-
-    if(MFLAGEP & move) {
-        if(pos->side == WHITE) {
-            AddPiece(to-10, pos, bP);
-        } else {
-            AddPiece(to+10, pos, wP);
-        }
-    } else if(MFLAGCA & move) {
-        switch(to) {
-            case C1: MovePiece(D1, A1, pos); break;
-            case C8: MovePiece(D8, A8, pos); break;
-            case G1: MovePiece(F1, H1, pos); break;
-            case G8: MovePiece(F8, H8, pos); break;
-            default: ASSERT(FALSE); break;
-        }
-    }
-
-    MovePiece(to, from, pos);
-
-    if(PieceKing[pos->pieces[from]]) {
-        pos->kingSq[pos->side] = from;
-    }
-
-    int captured = CAPTURED(move);
-
-    if(captured != EMPTY) {
-        ASSERT(PieceValid(captured));
-        AddPiece(to, pos, captured);
-    }
-
-    if(PROMOTED(move) != EMPTY) {
-        ASSERT(PieceValid(PROMOTED(move)) && !PiecePawn[PROMOTED(move)]);
-        ClearPiece(from, pos);
-        AddPiece(from, pos, (PieceCol[PROMOTED(move)] == WHITE ? wP : bP));
-    }
-
-    ASSERT(CheckBoard(pos));
-
+    ASSERT(!SqAttacked(pos->kingSq[side], pos->side, pos));
 }
 
 void MakeNullMove(Board *pos) {
@@ -296,37 +270,22 @@ void MakeNullMove(Board *pos) {
     ASSERT(!SqAttacked(pos->kingSq[pos->side], pos->side^1, pos));
 
     pos->ply++;
-    pos->history[pos->hisPly].posKey = pos->posKey;
 
     if(pos->enPas != NO_SQ) HASH_EP;
 
-    pos->history[pos->hisPly].move = NOMOVE;
-    pos->history[pos->hisPly].fiftyMove = pos->fiftyMove;
-    pos->history[pos->hisPly].enPas = pos->enPas;
-    pos->history[pos->hisPly].castlePerm = pos->castlePerm;
     pos->enPas = NO_SQ;
     pos->side ^= 1;
     pos->hisPly++;
+    pos->pliesFromNull = 0;
 
     HASH_SIDE;
     ASSERT(CheckBoard(pos));
 }
 
-void TakeNullMove(Board *pos) {
-    ASSERT(CheckBoard(pos));
-
-    pos->hisPly--;
-    pos->ply--;
-
-    if(pos->enPas != NO_SQ) HASH_EP;
-
-    pos->castlePerm = pos->history[pos->hisPly].castlePerm;
-    pos->fiftyMove = pos->history[pos->hisPly].fiftyMove;
-    pos->enPas = pos->history[pos->hisPly].enPas;
-
-    if(pos->enPas != NO_SQ) HASH_EP;
-
-    pos->side ^= 1;
-    HASH_SIDE;
-    ASSERT(CheckBoard(pos));
+// A move of the game itself rather than of a search line; the key it leaves
+// behind stays visible to repetition checks in later searches
+void MakeGameMove(Board *pos, SearchData *data, int move) {
+    ASSERT(pos->hisPly < MAX_GAME_MOVES);
+    data->gameKeys[pos->hisPly] = pos->posKey;
+    MakeMove(pos, move);
 }
@@ -4,32 +4,95 @@
 
 // Implementations for alo::MoveGenerator declared in include/alo/movegen.hpp
 
-#define MOVE(f, t, ca, pro, fl) ((f) | ((t) << 7) | ((ca) << 14) | ((pro) << 20) | (fl))
-#define SQOFFBOARD(sq) (FilesBrd[(sq)] == OFFBOARD)
-
-static const int LoopSlidePiece[8] = { wB, wR, wQ, 0, bB, bR, bQ, 0 };
-static const int LoopNonSlidePiece[6] = { wN, wK, 0, bN, bK, 0 };
-
-static const int LoopSlideIndex[2] = { 0, 4 };
-static const int LoopNonSlideIndex[2] = { 0, 3 };
-
-static const int PceDir[13][8] = {
-    { 0, 0, 0, 0, 0, 0, 0, 0 },
-    { 0, 0, 0, 0, 0, 0, 0, 0 },
-    { -8, -19, -21, -12, 8, 19, 21, 12 },
-    { -9, -11, 11, 9, 0, 0, 0, 0 },
-    { -1, -10, 1, 10, 0, 0, 0, 0 },
-    { -1, -10, 1, 10, -9, -11, 11, 9 },
-    { -1, -10, 1, 10, -9, -11, 11, 9 },
-    { 0, 0, 0, 0, 0, 0, 0, 0 },
-    { -8, -19, -21, -12, 8, 19, 21, 12 },
-    { -9, -11, 11, 9, 0, 0, 0, 0 },
-    { -1, -10, 1, 10, 0, 0, 0, 0 },
-    { -1, -10, 1, 10, -9, -11, 11, 9 },
-    { -1, -10, 1, 10, -9, -11, 11, 9 }
+#define MOVE(f64, t64, fl) ((f64) | ((t64) << 6) | (fl))
+
+// What a generator call produces. Every type yields legal moves only.
+enum GenType { CAPTURES, QUIETS, EVASIONS, QUIET_CHECKS, ALL };
+
+// Per-side constants, resolved at compile time; shifts are on the 64-square board
+template<int Us> struct SideConst {
+    static constexpr int Them = Us ^ 1;
+    static constexpr int Pawn = Us == WHITE ? wP : bP;
+    static constexpr int Knight = Us == WHITE ? wN : bN;
+    static constexpr int Bishop = Us == WHITE ? wB : bB;
+    static constexpr int Rook = Us == WHITE ? wR : bR;
+    static constexpr int Queen = Us == WHITE ? wQ : bQ;
+    static constexpr int Up = Us == WHITE ? 8 : -8;
+    static constexpr int UpLeft = Us == WHITE ? 7 : -9;
+    static constexpr int UpRight = Us == WHITE ? 9 : -7;
+    static constexpr int Rank3 = Us == WHITE ? RANK_3 : RANK_6;
+    static constexpr int Rank7 = Us == WHITE ? RANK_7 : RANK_2;
 };
 
-static const int NumDir[13] = { 0, 0, 8, 4, 4, 8, 8, 0, 8, 4, 4, 8, 8 };
+template<int D> static inline U64 Shift(const U64 b) {
+    if constexpr (D > 0) return b << D;
+    else return b >> -D;
+}
+
+// Computed once per node so every generated move is already legal
+typedef struct {
+    U64 checkers;  // enemy pieces giving check
+    U64 pinned;    // our pieces pinned to our king
+    U64 checkMask; // squares that resolve a single check, all squares when not in check
+    int kingSq;    // 64-based
+    // Only filled in for QUIET_CHECKS
+    U64 discovered; // our pieces whose move can uncover a check
+    int theirKingSq;
+} S_CHECKINFO;
+
+// Pieces of the owners set that stand alone between ksq and a slider of
+// sliderSide, i.e. the only thing stopping that slider from reaching ksq
+static U64 SliderBlockers(const Board *pos, const int ksq, const int sliderSide, const U64 owners) {
+    const U64 occ = pos->occBB[BOTH];
+    const U64 *bb = pos->pceBB;
+    U64 blockers = 0ULL;
+
+    U64 snipers = ((RookAttacks(ksq, 0ULL) & (bb[wR] | bb[bR] | bb[wQ] | bb[bQ]))
+                 | (BishopAttacks(ksq, 0ULL) & (bb[wB] | bb[bB] | bb[wQ] | bb[bQ]))) & pos->occBB[sliderSide];
+    while(snipers) {
+        int sq = POP(&snipers);
+        U64 between = BetweenBB[ksq][sq] & occ;
+        if(between && !(between & (between - 1)) && (between & owners)) {
+            blockers |= between;
+        }
+    }
+    return blockers;
+}
+
+static void InitCheckInfo(const Board *pos, S_CHECKINFO *ci) {
+    const int side = pos->side;
+    const U64 occ = pos->occBB[BOTH];
+    const U64 them = pos->occBB[side ^ 1];
+    const int ksq = SQ64(pos->kingSq[side]);
+
+    ci->kingSq = ksq;
+    ci->checkers = AttackersTo(pos, ksq, occ) & them;
+    ci->pinned = SliderBlockers(pos, ksq, side ^ 1, pos->occBB[side]);
+
+    if(!ci->checkers) {
+        ci->checkMask = ~0ULL;
+    } else {
+        int checker = __builtin_ctzll(ci->checkers);
+        ci->checkMask = BetweenBB[ksq][checker] | ci->checkers;
+    }
+}
+
+// A pinned piece may only move along the line through its king
+static inline int PinBroken(const S_CHECKINFO *ci, const int from64, const int to64) {
+    return (ci->pinned & SetMask[from64]) && !(LineBB[ci->kingSq][from64] & SetMask[to64]);
+}
+
+// En passant removes two pieces from the capturing rank, so test it directly
+static int EnPasLegal(const Board *pos, const S_CHECKINFO *ci, const int from64, const int to64) {
+    const int cap64 = pos->side == WHITE ? to64 - 8 : to64 + 8;
+    if(!(ci->checkMask & (SetMask[to64] | SetMask[cap64]))) return FALSE;
+
+    const U64 occ = (pos->occBB[BOTH] ^ SetMask[from64] ^ SetMask[cap64]) | SetMask[to64];
+    const U64 *bb = pos->pceBB;
+    const U64 them = pos->occBB[pos->side ^ 1];
+    return !(RookAttacks(ci->kingSq, occ) & them & (bb[wR] | bb[bR] | bb[wQ] | bb[bQ]))
+        && !(BishopAttacks(ci->kingSq, occ) & them & (bb[wB] | bb[bB] | bb[wQ] | bb[bQ]));
+}
 
 const int VictimScore[13] = { 0, 100, 200, 300, 400, 500, 600, 100, 200, 300, 400, 500, 600 };
 static int MvvLvaScores[13][13];
@@ -45,380 +108,505 @@ int InitMvvLva() {
     return 0;
 }
 
-static void AddQuietMove(Board *pos, int move, MoveList *list) {
-    list->moves[list->count].move = move;
-    if(pos->searchKillers[0][pos->ply] == move) {
-        list->moves[list->count].score = 900000;
-    }
-    else if(pos->searchKillers[1][pos->ply] == move) {
-        list->moves[list->count].score = 800000;
-    }
-    else {
-        list->moves[list->count].score = pos->searchHistory[pos->pieces[FROMSQ(move)]][TOSQ(move)];
-    }
+// Quiet moves are left unscored; the search orders them from its own tables
+static void AddQuietMove(int move, MoveList *list) {
+    list->moves[list->count] = move;
+    list->scores[list->count] = 0;
     list->count++;
 }
 
+// Promotion bonus by promotion code, knight to queen
+static const int PromotionScore[4] = { 100000, 300000, 500000, 900000 };
+
 static void AddCaptureMove(Board *pos, int move, MoveList *list) {
-    list->moves[list->count].move = move;
-    list->moves[list->count].score = MvvLvaScores[CAPTURED(move)][pos->pieces[FROMSQ(move)]] + 1000000;
-    if(PROMOTED(move)) {
-        switch(PROMOTED(move)) {
-            case wQ: case bQ: list->moves[list->count].score += 900000; break;
-            case wR: case bR: list->moves[list->count].score += 500000; break;
-            case wB: case bB: list->moves[list->count].score += 300000; break;
-            case wN: case bN: list->moves[list->count].score += 100000; break;
-        }
+    list->moves[list->count] = move;
+    list->scores[list->count] = MvvLvaScores[pos->pieces[TOSQ(move)]][pos->pieces[FROMSQ(move)]] + 1000000;
+    if(ISPROM(move)) {
+        list->scores[list->count] += PromotionScore[(move >> 12) & 3];
     }
     list->count++;
 }
 
 static void AddEnPassantMove(Board *pos, int move, MoveList *list) {
-    list->moves[list->count].move = move;
-    list->moves[list->count].score = 105 + 1000000;
+    list->moves[list->count] = move;
+    list->scores[list->count] = 105 + 1000000;
     list->count++;
 }
 
-static void AddWhitePawnMove(Board *pos, const int from, const int to, const int cap, MoveList *list) {
-    if(RanksBrd[from] == RANK_7) {
-        // Quiet promotions (no capture)
-        AddCaptureMove(pos, MOVE(from, to, EMPTY, wQ, 0), list); // boosted ordering
-        AddCaptureMove(pos, MOVE(from, to, EMPTY, wR, 0), list);
-        AddCaptureMove(pos, MOVE(from, to, EMPTY, wB, 0), list);
-        AddCaptureMove(pos, MOVE(from, to, EMPTY, wN, 0), list);
-    } else {
-        // Simple quiet push
-        AddQuietMove(pos, MOVE(from, to, EMPTY, EMPTY, 0), list);
-    }
+static void AddPromotions(Board *pos, const int from64, const int to64, const int flag, MoveList *list) {
+    // Quiet promotions go through AddCaptureMove too, for the ordering boost
+    AddCaptureMove(pos, MOVE(from64, to64, flag | MFLAGPROM | 0x3000), list);
+    AddCaptureMove(pos, MOVE(from64, to64, flag | MFLAGPROM | 0x2000), list);
+    AddCaptureMove(pos, MOVE(from64, to64, flag | MFLAGPROM | 0x1000), list);
+    AddCaptureMove(pos, MOVE(from64, to64, flag | MFLAGPROM), list);
 }
 
-static void AddWhitePawnCapture(Board *pos, const int from, const int to, const int cap, MoveList *list) {
-    if(RanksBrd[from] == RANK_7) {
-        AddCaptureMove(pos, MOVE(from, to, cap, wQ, 0), list);
-        AddCaptureMove(pos, MOVE(from, to, cap, wR, 0), list);
-        AddCaptureMove(pos, MOVE(from, to, cap, wB, 0), list);
-        AddCaptureMove(pos, MOVE(from, to, cap, wN, 0), list);
-    } else {
-        AddCaptureMove(pos, MOVE(from, to, cap, EMPTY, 0), list);
-    }
+// Pushing pawn gives check directly, or steps off the line of a slider it was blocking
+static inline int PawnPushChecks(const S_CHECKINFO *ci, const U64 pawnChecks, const int from64, const int to64) {
+    return (pawnChecks & SetMask[to64])
+        || ((ci->discovered & SetMask[from64]) && !(LineBB[ci->theirKingSq][from64] & SetMask[to64]));
 }
 
-static void AddBlackPawnMove(Board *pos, const int from, const int to, const int cap, MoveList *list) {
-    if(RanksBrd[from] == RANK_2) {
-        // Quiet promotions (no capture)
-        AddCaptureMove(pos, MOVE(from, to, EMPTY, bQ, 0), list);
-        AddCaptureMove(pos, MOVE(from, to, EMPTY, bR, 0), list);
-        AddCaptureMove(pos, MOVE(from, to, EMPTY, bB, 0), list);
-        AddCaptureMove(pos, MOVE(from, to, EMPTY, bN, 0), list);
-    } else {
-        // Simple quiet push
-        AddQuietMove(pos, MOVE(from, to, EMPTY, EMPTY, 0), list);
-    }
-}
-
-static void AddBlackPawnCapture(Board *pos, const int from, const int to, const int cap, MoveList *list) {
-    if(RanksBrd[from] == RANK_2) {
-        AddCaptureMove(pos, MOVE(from, to, cap, bQ, 0), list);
-        AddCaptureMove(pos, MOVE(from, to, cap, bR, 0), list);
-        AddCaptureMove(pos, MOVE(from, to, cap, bB, 0), list);
-        AddCaptureMove(pos, MOVE(from, to, cap, bN, 0), list);
-    } else {
-        AddCaptureMove(pos, MOVE(from, to, cap, EMPTY, 0), list);
-    }
-}
+// Pawn pushes land on empty squares and captures on enemy ones; targets
+// narrows both further (check mask, or empty squares for quiet types).
+template<int Us, GenType Type>
+static void AddPawnMoves(Board *pos, const S_CHECKINFO *ci, const U64 targets, MoveList *list) {
+    typedef SideConst<Us> S;
+    const U64 pawns = pos->pceBB[S::Pawn];
+    const U64 promoting = pawns & RankBBMask[S::Rank7];
+    const U64 others = pawns & ~RankBBMask[S::Rank7];
+    const U64 empty = ~pos->occBB[BOTH];
+    const U64 enemy = pos->occBB[S::Them] & targets;
+    int sq = 0; int t_sq = 0;
 
-void alo::MoveGenerator::generateAll(Board *pos, MoveList *list) {
-    ASSERT(CheckBoard(pos));
+    if constexpr (Type != CAPTURES) {
+        U64 pushes = Shift<S::Up>(others) & empty;
+        U64 doubles = Shift<S::Up>(pushes & RankBBMask[S::Rank3]) & empty & targets;
+        pushes &= targets;
 
-    list->count = 0;
+        U64 pawnChecks = 0ULL;
+        if constexpr (Type == QUIET_CHECKS) {
+            pawnChecks = PawnAttacks[S::Them][ci->theirKingSq];
+        }
 
-    int pce = EMPTY;
-    int side = pos->side;
-    int sq = 0; int t_sq = 0;
-    int pceNum = 0; 
-    int pceIndex = 0;
-    int index = 0;
-
-    if(side == WHITE) {
-        for(pceNum = 0; pceNum<pos->pceNum[wP]; ++pceNum) {
-            sq = pos->plist[wP][pceNum];
-            ASSERT(SqOnBoard(sq));
-
-            if(pos->pieces[sq + 10] == EMPTY) {
-                AddWhitePawnMove(pos, sq, sq+10, EMPTY, list);
-                if(RanksBrd[sq] == RANK_2 && pos->pieces[sq + 20] == EMPTY) {
-                    AddQuietMove(pos, MOVE(sq, (sq+20), EMPTY, EMPTY, MFLAGPS), list);
-                }
+        while(pushes) {
+            t_sq = POP(&pushes);
+            if constexpr (Type == QUIET_CHECKS) {
+                if(!PawnPushChecks(ci, pawnChecks, t_sq - S::Up, t_sq)) continue;
             }
-
-            if(!SQOFFBOARD(sq + 9) && PieceCol[pos->pieces[sq + 9]] == BLACK) {
-                AddWhitePawnCapture(pos, sq, sq+9, pos->pieces[sq + 9], list);
+            if(PinBroken(ci, t_sq - S::Up, t_sq)) continue;
+            AddQuietMove(MOVE(t_sq - S::Up, t_sq, 0), list);
+        }
+        while(doubles) {
+            t_sq = POP(&doubles);
+            if constexpr (Type == QUIET_CHECKS) {
+                if(!PawnPushChecks(ci, pawnChecks, t_sq - 2 * S::Up, t_sq)) continue;
             }
+            if(PinBroken(ci, t_sq - 2 * S::Up, t_sq)) continue;
+            AddQuietMove(MOVE(t_sq - 2 * S::Up, t_sq, MFLAGPS), list);
+        }
+    }
 
-            if(!SQOFFBOARD(sq + 11) && PieceCol[pos->pieces[sq + 11]] == BLACK) {
-                AddWhitePawnCapture(pos, sq, sq+11, pos->pieces[sq + 11], list);
-            }
-            if(pos->enPas != NO_SQ) {
-                if(pos->enPas == (sq + 9)) {
-                    AddEnPassantMove(pos, MOVE(sq, sq+9, EMPTY, EMPTY, MFLAGEP), list);
-                }
-                if(pos->enPas == (sq + 11)) {
-                    AddEnPassantMove(pos, MOVE(sq, sq+11, EMPTY, EMPTY, MFLAGEP), list);
-                }
+    // Quiet checks leave promotions to the capture and quiet generators
+    if constexpr (Type == QUIET_CHECKS) {
+        return;
+    }
+
+    if(promoting) {
+        if constexpr (Type != CAPTURES) {
+            U64 pushes = Shift<S::Up>(promoting) & empty & targets;
+            while(pushes) {
+                t_sq = POP(&pushes);
+                if(PinBroken(ci, t_sq - S::Up, t_sq)) continue;
+                AddPromotions(pos, t_sq - S::Up, t_sq, 0, list);
             }
         }
-        if(pos->castlePerm & WKCA) {
-            if(pos->pieces[F1] == EMPTY && pos->pieces[G1] == EMPTY) {
-                if(!SqAttacked(E1, BLACK, pos) && !SqAttacked(F1, BLACK, pos) && !SqAttacked(G1, BLACK, pos)) {
-                    AddQuietMove(pos, MOVE(E1, G1, EMPTY, EMPTY, MFLAGCA), list);
-                }
+        if constexpr (Type != QUIETS) {
+            U64 capLeft = Shift<S::UpLeft>(promoting & ~FileBBMask[FILE_A]) & enemy;
+            U64 capRight = Shift<S::UpRight>(promoting & ~FileBBMask[FILE_H]) & enemy;
+            while(capLeft) {
+                t_sq = POP(&capLeft);
+                if(PinBroken(ci, t_sq - S::UpLeft, t_sq)) continue;
+                AddPromotions(pos, t_sq - S::UpLeft, t_sq, MFLAGCAP, list);
+            }
+            while(capRight) {
+                t_sq = POP(&capRight);
+                if(PinBroken(ci, t_sq - S::UpRight, t_sq)) continue;
+                AddPromotions(pos, t_sq - S::UpRight, t_sq, MFLAGCAP, list);
             }
         }
+    }
 
-        if(pos->castlePerm & WQCA) {
-            if(pos->pieces[D1] == EMPTY && pos->pieces[C1] == EMPTY && pos->pieces[B1] == EMPTY) {
-                if(!SqAttacked(E1, BLACK, pos) && !SqAttacked(D1, BLACK, pos) && !SqAttacked(C1, BLACK, pos)) {
-                    AddQuietMove(pos, MOVE(E1, C1, EMPTY, EMPTY, MFLAGCA), list);
-                }
-            }
+    if constexpr (Type != QUIETS) {
+        U64 capLeft = Shift<S::UpLeft>(others & ~FileBBMask[FILE_A]) & enemy;
+        U64 capRight = Shift<S::UpRight>(others & ~FileBBMask[FILE_H]) & enemy;
+        while(capLeft) {
+            t_sq = POP(&capLeft);
+            if(PinBroken(ci, t_sq - S::UpLeft, t_sq)) continue;
+            AddCaptureMove(pos, MOVE(t_sq - S::UpLeft, t_sq, MFLAGCAP), list);
+        }
+        while(capRight) {
+            t_sq = POP(&capRight);
+            if(PinBroken(ci, t_sq - S::UpRight, t_sq)) continue;
+            AddCaptureMove(pos, MOVE(t_sq - S::UpRight, t_sq, MFLAGCAP), list);
         }
-    } else {
-        for(pceNum = 0; pceNum<pos->pceNum[bP]; ++pceNum) {
-            sq = pos->plist[bP][pceNum];
-            ASSERT(SqOnBoard(sq));
-
-            if(pos->pieces[sq - 10] == EMPTY) {
-                AddBlackPawnMove(pos, sq, sq-10, EMPTY, list);
-                if(RanksBrd[sq] == RANK_7 && pos->pieces[sq - 20] == EMPTY) {
-                    AddQuietMove(pos, MOVE(sq, (sq-20), EMPTY, EMPTY, MFLAGPS), list);
-                }
-            }
 
-            if(!SQOFFBOARD(sq - 9) && PieceCol[pos->pieces[sq - 9]] == WHITE) {
-                AddBlackPawnCapture(pos, sq, sq-9, pos->pieces[sq - 9], list);
+        if(pos->enPas != NO_SQ) {
+            U64 attackers = PawnAttacks[S::Them][SQ64(pos->enPas)] & others;
+            while(attackers) {
+                sq = POP(&attackers);
+                if(!EnPasLegal(pos, ci, sq, SQ64(pos->enPas))) continue;
+                AddEnPassantMove(pos, MOVE(sq, SQ64(pos->enPas), MFLAGEP), list);
             }
+        }
+    }
+}
 
-            if(!SQOFFBOARD(sq -11) && PieceCol[pos->pieces[sq - 11]] == WHITE) {
-                AddBlackPawnCapture(pos, sq, sq-11, pos->pieces[sq - 11], list);
-            }
-            if(pos->enPas != NO_SQ) {
-                if(pos->enPas == (sq - 9)) {
-                    AddEnPassantMove(pos, MOVE(sq, sq-9, EMPTY, EMPTY, MFLAGEP), list);
-                }
-                if(pos->enPas == (sq - 11)) {
-                    AddEnPassantMove(pos, MOVE(sq, sq-11, EMPTY, EMPTY, MFLAGEP), list);
-                }
-            }
+template<int Pce> static inline U64 PieceAttacks(const int sq, const U64 occ) {
+    if constexpr (Pce == wN || Pce == bN) return KnightAttacks[sq];
+    else if constexpr (Pce == wB || Pce == bB) return BishopAttacks(sq, occ);
+    else if constexpr (Pce == wR || Pce == bR) return RookAttacks(sq, occ);
+    else return BishopAttacks(sq, occ) | RookAttacks(sq, occ);
+}
+
+template<GenType Type> static inline void AddPieceMove(Board *pos, const int from64, const int to64, MoveList *list) {
+    if constexpr (Type == QUIETS || Type == QUIET_CHECKS) {
+        AddQuietMove(MOVE(from64, to64, 0), list);
+    } else if constexpr (Type == CAPTURES) {
+        AddCaptureMove(pos, MOVE(from64, to64, MFLAGCAP), list);
+    } else {
+        if(pos->pieces[SQ120(to64)] != EMPTY) {
+            AddCaptureMove(pos, MOVE(from64, to64, MFLAGCAP), list);
+        } else {
+            AddQuietMove(MOVE(from64, to64, 0), list);
         }
+    }
+}
 
-        if(pos->castlePerm & BKCA) {
-            if(pos->pieces[F8] == EMPTY && pos->pieces[G8] == EMPTY) {
-                if(!SqAttacked(E8, WHITE, pos) && !SqAttacked(F8, WHITE, pos) && !SqAttacked(G8, WHITE, pos)) {
-                    AddQuietMove(pos, MOVE(E8, G8, EMPTY, EMPTY, MFLAGCA), list);
-                }
-            }
+template<int Pce, GenType Type>
+static void AddPieceMoves(Board *pos, const S_CHECKINFO *ci, const U64 targets, MoveList *list) {
+    const U64 occ = pos->occBB[BOTH];
+    U64 pieces = pos->pceBB[Pce];
+    int sq = 0;
+
+    // A piece checks from the squares it would attack standing on the enemy king
+    U64 checkSq = 0ULL;
+    if constexpr (Type == QUIET_CHECKS) {
+        checkSq = PieceAttacks<Pce>(ci->theirKingSq, occ);
+    }
+
+    while(pieces) {
+        sq = POP(&pieces);
+        U64 moves = PieceAttacks<Pce>(sq, occ) & targets;
+        if(ci->pinned & SetMask[sq]) {
+            moves &= LineBB[ci->kingSq][sq];
+        }
+        if constexpr (Type == QUIET_CHECKS) {
+            moves &= (ci->discovered & SetMask[sq]) ? (checkSq | ~LineBB[ci->theirKingSq][sq]) : checkSq;
         }
+        while(moves) {
+            AddPieceMove<Type>(pos, sq, POP(&moves), list);
+        }
+    }
+}
+
+// King steps to squares no enemy piece attacks once the king has left its square
+template<GenType Type>
+static void AddKingMoves(Board *pos, const S_CHECKINFO *ci, const U64 targets, MoveList *list) {
+    const U64 occ = pos->occBB[BOTH] ^ SetMask[ci->kingSq];
+    const U64 them = pos->occBB[pos->side ^ 1];
+    U64 moves = KingAttacks[ci->kingSq] & targets;
+    int t_sq = 0;
+
+    while(moves) {
+        t_sq = POP(&moves);
+        if(AttackersTo(pos, t_sq, occ) & them) continue;
+        AddPieceMove<Type>(pos, ci->kingSq, t_sq, list);
+    }
+}
 
-        if(pos->castlePerm & BQCA) {
-            if(pos->pieces[D8] == EMPTY && pos->pieces[C8] == EMPTY && pos->pieces[B8] == EMPTY) {
-                if(!SqAttacked(E8, WHITE, pos) && !SqAttacked(D8, WHITE, pos) && !SqAttacked(C8, WHITE, pos)) {
-                    AddQuietMove(pos, MOVE(E8, C8, EMPTY, EMPTY, MFLAGCA), list);
-                }
+// Only called when not in check, so the king's own square needs no test
+template<int Us> static void AddCastling(Board *pos, MoveList *list) {
+    constexpr int Them = Us ^ 1;
+    constexpr int KingSide = Us == WHITE ? WKCA : BKCA;
+    constexpr int QueenSide = Us == WHITE ? WQCA : BQCA;
+    constexpr int E = Us == WHITE ? E1 : E8;
+    ASSERT(!SqAttacked(pos->kingSq[Us], Them, pos));
+
+    if(pos->castlePerm & KingSide) {
+        if(pos->pieces[E + 1] == EMPTY && pos->pieces[E + 2] == EMPTY) {
+            if(!SqAttacked(E + 1, Them, pos) && !SqAttacked(E + 2, Them, pos)) {
+                AddQuietMove(MOVE(SQ64(E), SQ64(E + 2), MFLAGCA), list);
             }
         }
     }
 
-    int dir = 0;
-
-    //Sliding pieces
-    pceIndex = LoopSlideIndex[side];
-    pce = LoopSlidePiece[pceIndex++];
-
-    while(pce != 0) {
-        ASSERT(PieceValid(pce));
-        for(pceNum = 0; pceNum<pos->pceNum[pce]; ++pceNum) {
-            sq = pos->plist[pce][pceNum];
-            ASSERT(SqOnBoard(sq));
-            for(index = 0; index < NumDir[pce]; ++index) {
-                dir = PceDir[pce][index];
-                t_sq = sq + dir;
-                while(!SQOFFBOARD(t_sq)) {
-                    if(pos->pieces[t_sq] != EMPTY) {
-                        if(PieceCol[pos->pieces[t_sq]] != side) {
-                            AddCaptureMove(pos, MOVE(sq, t_sq, pos->pieces[t_sq], EMPTY, 0), list);
-                        }
-                        break;
-                    }
-                    AddQuietMove(pos, MOVE(sq, t_sq, EMPTY, EMPTY, 0), list);
-                    t_sq += dir;
-                }
+    if(pos->castlePerm & QueenSide) {
+        if(pos->pieces[E - 1] == EMPTY && pos->pieces[E - 2] == EMPTY && pos->pieces[E - 3] == EMPTY) {
+            if(!SqAttacked(E - 1, Them, pos) && !SqAttacked(E - 2, Them, pos)) {
+                AddQuietMove(MOVE(SQ64(E), SQ64(E - 2), MFLAGCA), list);
             }
         }
+    }
+}
 
-        pce = LoopSlidePiece[pceIndex++];
+template<int Us, GenType Type>
+static void GenerateMoves(Board *pos, const S_CHECKINFO *ci, MoveList *list) {
+    typedef SideConst<Us> S;
+    U64 targets;
+    if constexpr (Type == CAPTURES) {
+        targets = pos->occBB[S::Them];
+    } else if constexpr (Type == QUIETS || Type == QUIET_CHECKS) {
+        targets = ~pos->occBB[BOTH];
+    } else {
+        targets = ~pos->occBB[Us];
     }
 
-    //Non-sliding pieces;
-
-    pceIndex = LoopNonSlideIndex[side];
-    pce = LoopNonSlidePiece[pceIndex++];
-    
-    while(pce != 0) {
-        ASSERT(PieceValid(pce));
-        for(pceNum = 0; pceNum<pos->pceNum[pce]; ++pceNum) {
-            sq = pos->plist[pce][pceNum];
-            ASSERT(SqOnBoard(sq));
-            for(index = 0; index < NumDir[pce]; ++index) {
-                dir = PceDir[pce][index];
-                t_sq = sq + dir;
-                if(SQOFFBOARD(t_sq)) {
-                    continue;
-                }
-                if(pos->pieces[t_sq] != EMPTY) {
-                    if(PieceCol[pos->pieces[t_sq]] != side) {
-                        AddCaptureMove(pos, MOVE(sq, t_sq, pos->pieces[t_sq], EMPTY, 0), list);
-                    }
-                    continue;
-                }
-                AddQuietMove(pos, MOVE(sq, t_sq, EMPTY, EMPTY, 0), list);
-            }
+    if constexpr (Type == QUIET_CHECKS) {
+        // The king can only check by uncovering a slider
+        if(ci->discovered & SetMask[ci->kingSq]) {
+            AddKingMoves<Type>(pos, ci, targets & ~LineBB[ci->theirKingSq][ci->kingSq], list);
+        }
+    } else {
+        AddKingMoves<Type>(pos, ci, targets, list);
+    }
+
+    if constexpr (Type == CAPTURES || Type == EVASIONS) {
+        // Only the king can answer a double check
+        if(ci->checkers & (ci->checkers - 1)) {
+            return;
         }
+        targets &= ci->checkMask;
+    }
+
+    AddPawnMoves<Us, Type>(pos, ci, targets, list);
 
-        pce = LoopNonSlidePiece[pceIndex++];
+    if constexpr (Type == ALL || Type == QUIETS) {
+        AddCastling<Us>(pos, list);
+    }
+
+    AddPieceMoves<S::Knight, Type>(pos, ci, targets, list);
+    AddPieceMoves<S::Bishop, Type>(pos, ci, targets, list);
+    AddPieceMoves<S::Rook, Type>(pos, ci, targets, list);
+    AddPieceMoves<S::Queen, Type>(pos, ci, targets, list);
+}
+
+template<GenType Type> static void Generate(Board *pos, const S_CHECKINFO *ci, MoveList *list) {
+    ASSERT(CheckBoard(pos));
+    list->count = 0;
+    if(pos->side == WHITE) {
+        GenerateMoves<WHITE, Type>(pos, ci, list);
+    } else {
+        GenerateMoves<BLACK, Type>(pos, ci, list);
+    }
+}
+
+void alo::MoveGenerator::generateAll(Board *pos, MoveList *list) {
+    S_CHECKINFO ci[1];
+    InitCheckInfo(pos, ci);
+    if(ci->checkers) {
+        Generate<EVASIONS>(pos, ci, list);
+    } else {
+        Generate<ALL>(pos, ci, list);
     }
 }
 
 void alo::MoveGenerator::generateCaptures(Board *pos, MoveList *list) {
+    S_CHECKINFO ci[1];
+    InitCheckInfo(pos, ci);
+    Generate<CAPTURES>(pos, ci, list);
+}
+
+void alo::MoveGenerator::generateQuiets(Board *pos, MoveList *list) {
+    S_CHECKINFO ci[1];
+    InitCheckInfo(pos, ci);
+    ASSERT(!ci->checkers);
+    Generate<QUIETS>(pos, ci, list);
+}
+
+// King steps, then captures of a single checker and interpositions
+void alo::MoveGenerator::generateEvasions(Board *pos, MoveList *list) {
+    S_CHECKINFO ci[1];
+    InitCheckInfo(pos, ci);
+    ASSERT(ci->checkers);
+    Generate<EVASIONS>(pos, ci, list);
+}
+
+// Non-capturing moves that give check, directly or by uncovering a slider.
+// Promotions and castling are left out; the side to move must not be in check.
+void alo::MoveGenerator::generateQuietChecks(Board *pos, MoveList *list) {
+    S_CHECKINFO ci[1];
+    InitCheckInfo(pos, ci);
+    ASSERT(!ci->checkers);
+    ci->theirKingSq = SQ64(pos->kingSq[pos->side ^ 1]);
+    ci->discovered = SliderBlockers(pos, ci->theirKingSq, pos->side, pos->occBB[pos->side]);
+    Generate<QUIET_CHECKS>(pos, ci, list);
+}
+
+// Rights, empty path and unattacked king path; the rook is on its corner
+// whenever the right is still held
+static int CastleAllowed(Board *pos, const int from, const int to) {
+    const int side = pos->side;
+    const int e = side == WHITE ? E1 : E8;
+    if(from != e) return FALSE;
+
+    if(to == e + 2) {
+        return (pos->castlePerm & (side == WHITE ? WKCA : BKCA))
+            && pos->pieces[e + 1] == EMPTY && pos->pieces[e + 2] == EMPTY
+            && !SqAttacked(e, side ^ 1, pos) && !SqAttacked(e + 1, side ^ 1, pos) && !SqAttacked(e + 2, side ^ 1, pos);
+    }
+    if(to == e - 2) {
+        return (pos->castlePerm & (side == WHITE ? WQCA : BQCA))
+            && pos->pieces[e - 1] == EMPTY && pos->pieces[e - 2] == EMPTY && pos->pieces[e - 3] == EMPTY
+            && !SqAttacked(e, side ^ 1, pos) && !SqAttacked(e - 1, side ^ 1, pos) && !SqAttacked(e - 2, side ^ 1, pos);
+    }
+    return FALSE;
+}
+
+// Whether move is one the generator could produce here, ignoring whether it
+// leaves the own king attacked. Used for hash and killer moves, which may come
+// from another position, without generating a move list.
+int alo::MoveGenerator::isPseudoLegal(Board *pos, const int move) {
     ASSERT(CheckBoard(pos));
 
-    list->count = 0;
+    if(move == NOMOVE || (move & ~0xFFFF)) return FALSE;
 
-    int pce = EMPTY;
-    int side = pos->side;
-    int sq = 0; int t_sq = 0;
-    int pceNum = 0; 
-    int pceIndex = 0;
-    int index = 0;
+    const int from = FROMSQ(move);
+    const int to = TOSQ(move);
+    const int from64 = FROM64(move);
+    const int to64 = TO64(move);
+    const int flag = MFLAG(move);
+    const int side = pos->side;
+    const int pce = pos->pieces[from];
+    const int captured = pos->pieces[to];
+    if(pce == EMPTY || PieceCol[pce] != side) return FALSE;
 
-    if(side == WHITE) {
-        for(pceNum = 0; pceNum<pos->pceNum[wP]; ++pceNum) {
-            sq = pos->plist[wP][pceNum];
-            ASSERT(SqOnBoard(sq));
+    if(flag == MFLAGEP) {
+        return PiecePawn[pce] && to == pos->enPas && (PawnAttacks[side][from64] & SetMask[to64]) != 0;
+    }
 
-            if(!SQOFFBOARD(sq + 9) && PieceCol[pos->pieces[sq + 9]] == BLACK) {
-                AddWhitePawnCapture(pos, sq, sq+9, pos->pieces[sq + 9], list);
-            }
+    // Apart from en passant the capture bit says exactly whether the target is occupied
+    if((captured != EMPTY) != ((move & MFLAGCAP) != 0)) return FALSE;
+    if(captured != EMPTY && (PieceCol[captured] == side || IsKi(captured))) return FALSE;
 
-            if(!SQOFFBOARD(sq + 11) && PieceCol[pos->pieces[sq + 11]] == BLACK) {
-                AddWhitePawnCapture(pos, sq, sq+11, pos->pieces[sq + 11], list);
-            }
-            if(pos->enPas != NO_SQ) {
-                if(pos->enPas == (sq + 9)) {
-                    AddEnPassantMove(pos, MOVE(sq, sq+9, EMPTY, EMPTY, MFLAGEP), list);
-                }
-                if(pos->enPas == (sq + 11)) {
-                    AddEnPassantMove(pos, MOVE(sq, sq+11, EMPTY, EMPTY, MFLAGEP), list);
-                }
-            }
-        }
-    } else {
-        for(pceNum = 0; pceNum<pos->pceNum[bP]; ++pceNum) {
-            sq = pos->plist[bP][pceNum];
-            ASSERT(SqOnBoard(sq));
+    if(flag == MFLAGCA) {
+        return IsKi(pce) && CastleAllowed(pos, from, to);
+    }
 
-            if(!SQOFFBOARD(sq - 9) && PieceCol[pos->pieces[sq - 9]] == WHITE) {
-                AddBlackPawnCapture(pos, sq, sq-9, pos->pieces[sq - 9], list);
-            }
+    if(PiecePawn[pce]) {
+        const int up = side == WHITE ? 10 : -10;
+        const int promotes = RanksBrd[to] == (side == WHITE ? RANK_8 : RANK_1);
+        if(promotes != (ISPROM(move) != 0)) return FALSE;
 
-            if(!SQOFFBOARD(sq -11) && PieceCol[pos->pieces[sq - 11]] == WHITE) {
-                AddBlackPawnCapture(pos, sq, sq-11, pos->pieces[sq - 11], list);
-            }
-            if(pos->enPas != NO_SQ) {
-                if(pos->enPas == (sq - 9)) {
-                    AddEnPassantMove(pos, MOVE(sq, sq-9, EMPTY, EMPTY, MFLAGEP), list);
-                }
-                if(pos->enPas == (sq - 11)) {
-                    AddEnPassantMove(pos, MOVE(sq, sq-11, EMPTY, EMPTY, MFLAGEP), list);
-                }
-            }
+        if(flag == MFLAGPS) {
+            return RanksBrd[from] == (side == WHITE ? RANK_2 : RANK_7)
+                && to == from + 2 * up && pos->pieces[from + up] == EMPTY;
         }
+        if(!promotes && flag != 0 && flag != MFLAGCAP) return FALSE;
+        if(captured == EMPTY) {
+            return to == from + up;
+        }
+        return (PawnAttacks[side][from64] & SetMask[to64]) != 0;
     }
 
-    int dir = 0;
-
-    //Sliding pieces
-    pceIndex = LoopSlideIndex[side];
-    pce = LoopSlidePiece[pceIndex++];
-
-    while(pce != 0) {
-        ASSERT(PieceValid(pce));
-        for(pceNum = 0; pceNum<pos->pceNum[pce]; ++pceNum) {
-            sq = pos->plist[pce][pceNum];
-            ASSERT(SqOnBoard(sq));
-            for(index = 0; index < NumDir[pce]; ++index) {
-                dir = PceDir[pce][index];
-                t_sq = sq + dir;
-                while(!SQOFFBOARD(t_sq)) {
-                    if(pos->pieces[t_sq] != EMPTY) {
-                        if(PieceCol[pos->pieces[t_sq]] != side) {
-                            AddCaptureMove(pos, MOVE(sq, t_sq, pos->pieces[t_sq], EMPTY, 0), list);
-                        }
-                        break;
-                    }
-                    t_sq += dir;
-                }
-            }
-        }
+    if(flag != 0 && flag != MFLAGCAP) return FALSE;
 
-        pce = LoopSlidePiece[pceIndex++];
+    U64 attacks;
+    if(IsKi(pce)) {
+        attacks = KingAttacks[from64];
+    } else if(IsKn(pce)) {
+        attacks = KnightAttacks[from64];
+    } else {
+        const U64 occ = pos->occBB[BOTH];
+        attacks = (IsBQ(pce) ? BishopAttacks(from64, occ) : 0ULL) | (IsRQ(pce) ? RookAttacks(from64, occ) : 0ULL);
     }
+    return (attacks & SetMask[to64]) != 0;
+}
 
-    //Non-sliding pieces;
-
-    pceIndex = LoopNonSlideIndex[side];
-    pce = LoopNonSlidePiece[pceIndex++];
-    
-    while(pce != 0) {
-        ASSERT(PieceValid(pce));
-        for(pceNum = 0; pceNum<pos->pceNum[pce]; ++pceNum) {
-            sq = pos->plist[pce][pceNum];
-            ASSERT(SqOnBoard(sq));
-            for(index = 0; index < NumDir[pce]; ++index) {
-                dir = PceDir[pce][index];
-                t_sq = sq + dir;
-                if(SQOFFBOARD(t_sq)) {
-                    continue;
-                }
-                if(pos->pieces[t_sq] != EMPTY) {
-                    if(PieceCol[pos->pieces[t_sq]] != side) {
-                        AddCaptureMove(pos, MOVE(sq, t_sq, pos->pieces[t_sq], EMPTY, 0), list);
-                    }
-                    continue;
-                }
-            }
-        }
+// Whether a pseudo-legal move keeps the own king out of check. Only the
+// occupancy changes, so one attackers query on the king square decides it.
+int alo::MoveGenerator::isLegal(Board *pos, const int move) {
+    ASSERT(isPseudoLegal(pos, move));
+
+    // The king's path was tested for attacks already
+    if(ISCA(move)) return TRUE;
+
+    const int side = pos->side;
+    const int from64 = FROM64(move);
+    const int to64 = TO64(move);
+    const int ksq = SQ64(pos->kingSq[side]);
+
+    // A captured piece no longer attacks anything
+    U64 removed = SetMask[to64];
+    U64 occ = (pos->occBB[BOTH] ^ SetMask[from64]) | SetMask[to64];
+    if(ISEP(move)) {
+        const int cap64 = side == WHITE ? to64 - 8 : to64 + 8;
+        occ ^= SetMask[cap64];
+        removed |= SetMask[cap64];
+    }
 
-        pce = LoopNonSlidePiece[pceIndex++];
+    const int target = from64 == ksq ? to64 : ksq;
+    return !(AttackersTo(pos, target, occ) & pos->occBB[side ^ 1] & ~removed);
+}
+
+void alo::MoveGenerator::initCheckSquares(const Board *pos, S_CHECKSQ *cs) {
+    const int side = pos->side;
+    const int eksq = SQ64(pos->kingSq[side ^ 1]);
+    const U64 occ = pos->occBB[BOTH];
+    const U64 bishop = BishopAttacks(eksq, occ);
+    const U64 rook = RookAttacks(eksq, occ);
+    const int base = side == WHITE ? wP : bP;
+
+    cs->theirKingSq = eksq;
+    cs->discovered = SliderBlockers(pos, eksq, side, pos->occBB[side]);
+    for(int pce = 0; pce < 13; ++pce) {
+        cs->checkSq[pce] = 0ULL;
     }
+    cs->checkSq[base] = PawnAttacks[side ^ 1][eksq];
+    cs->checkSq[base + 1] = KnightAttacks[eksq];
+    cs->checkSq[base + 2] = bishop;
+    cs->checkSq[base + 3] = rook;
+    cs->checkSq[base + 4] = bishop | rook;
 }
 
-int alo::MoveGenerator::moveExists(Board *pos, const int move) {
-    MoveList list[1];
-    generateAll(pos, list);
-    int MoveNum = 0;
-    for(MoveNum = 0; MoveNum < list->count; ++MoveNum) {
-        if(!MakeMove(pos, list->moves[MoveNum].move)) {
-            continue;
-        }
-        TakeMove(pos);
-        if(list->moves[MoveNum].move == move) {
-            return TRUE;
+// Whether a legal move checks the enemy king. Ordinary moves are answered
+// from the check squares and discovery candidates; promotions, en passant
+// and castling change the occupancy in ways those miss and are worked out.
+int alo::MoveGenerator::givesCheck(const Board *pos, const S_CHECKSQ *cs, const int move) {
+    const int from = FROMSQ(move);
+    const int to = TOSQ(move);
+    const int from64 = FROM64(move);
+    const int to64 = TO64(move);
+    const int eksq = cs->theirKingSq;
+    const int side = pos->side;
+
+    const U64 *bb = pos->pceBB;
+    U64 occ = pos->occBB[BOTH] ^ SetMask[from64];
+    const int promoted = PROMOTED(move, side);
+
+    if(promoted) {
+        // The promoted piece may see through the square the pawn left
+        U64 attacks = KnightAttacks[to64];
+        if(!IsKn(promoted)) {
+            attacks = (IsBQ(promoted) ? BishopAttacks(to64, occ) : 0ULL) | (IsRQ(promoted) ? RookAttacks(to64, occ) : 0ULL);
         }
+        if(attacks & SetMask[eksq]) return TRUE;
+    } else if(cs->checkSq[pos->pieces[from]] & SetMask[to64]) {
+        return TRUE;
     }
-    return FALSE;
+
+    if((cs->discovered & SetMask[from64]) && !(LineBB[eksq][from64] & SetMask[to64])) return TRUE;
+
+    if(ISEP(move)) {
+        // The captured pawn may have been the only piece blocking a slider
+        occ ^= SetMask[side == WHITE ? to64 - 8 : to64 + 8];
+        occ |= SetMask[to64];
+        const U64 rookQueens = side == WHITE ? (bb[wR] | bb[wQ]) : (bb[bR] | bb[bQ]);
+        const U64 bishopQueens = side == WHITE ? (bb[wB] | bb[wQ]) : (bb[bB] | bb[bQ]);
+        return ((RookAttacks(eksq, occ) & rookQueens) | (BishopAttacks(eksq, occ) & bishopQueens)) != 0;
+    }
+
+    if(!ISCA(move)) return FALSE;
+
+    // Castling: only the rook, on the square the king passed over, can check
+    const int rookFrom = SQ64(to > from ? from + 3 : from - 4);
+    const int rookTo = SQ64(to > from ? from + 1 : from - 1);
+    occ = (occ ^ SetMask[rookFrom]) | SetMask[to64] | SetMask[rookTo];
+    return (RookAttacks(rookTo, occ) & SetMask[eksq]) != 0;
+}
+
+int alo::MoveGenerator::moveExists(Board *pos, const int move) {
+    return isPseudoLegal(pos, move) && isLegal(pos, move);
 }
 
 // C API wrappers
 void GenerateAllMoves(Board *pos, MoveList *list) { alo::MoveGenerator::generateAll(pos, list); }
 void GenerateAllCaptures(Board *pos, MoveList *list) { alo::MoveGenerator::generateCaptures(pos, list); }
+void GenerateQuiets(Board *pos, MoveList *list) { alo::MoveGenerator::generateQuiets(pos, list); }
+void GenerateEvasions(Board *pos, MoveList *list) { alo::MoveGenerator::generateEvasions(pos, list); }
+void GenerateQuietChecks(Board *pos, MoveList *list) { alo::MoveGenerator::generateQuietChecks(pos, list); }
 int MoveExists(Board *pos, const int move) { return alo::MoveGenerator::moveExists(pos, move); }
+int IsPseudoLegal(Board *pos, const int move) { return alo::MoveGenerator::isPseudoLegal(pos, move); }
+int IsLegal(Board *pos, const int move) { return alo::MoveGenerator::isLegal(pos, move); }
+void InitCheckSquares(const Board *pos, S_CHECKSQ *cs) { alo::MoveGenerator::initCheckSquares(pos, cs); }
+int GivesCheck(const Board *pos, const S_CHECKSQ *cs, const int move) { return alo::MoveGenerator::givesCheck(pos, cs, move); }
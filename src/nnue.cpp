@@ -215,10 +215,9 @@ static void encode_halfkp_features(const Board* pos, std::vector<int>& feats) {
         int hp_idx = PieceToHalfKPIndex[piece];
         if (hp_idx < 0) continue;
 
-        const int num = pos->pceNum[piece];
-        for (int i = 0; i < num; ++i) {
-            const int sq120 = pos->plist[piece][i];
-            const int sq64  = SQ64(sq120);
+        U64 pieces = pos->pceBB[piece];
+        while (pieces) {
+            const int sq64  = POP(&pieces);
 
             // white perspective
             {
@@ -10,13 +10,17 @@ void Perft(int depth, Board *pos) {
     }
     MoveList list[1];
     GenerateAllMoves(pos, list);
+    // Every generated move is legal, so the last ply is just the list size
+    if(depth == 1) {
+        leafNodes += list->count;
+        return;
+    }
     int moveNum = 0;
+    Board child[1];
     for(moveNum = 0; moveNum < list->count; ++moveNum) {
-        if(!MakeMove(pos, list->moves[moveNum].move)) {
-            continue;
-        }
-        Perft(depth - 1, pos);
-        TakeMove(pos);
+        *child = *pos;
+        MakeMove(child, list->moves[moveNum]);
+        Perft(depth - 1, child);
     }
     return;
 }
@@ -30,15 +34,13 @@ void PerftTest(int depth, Board *pos) {
     GenerateAllMoves(pos, list);
     int move;
     int moveNum = 0;
+    Board child[1];
     for(moveNum = 0; moveNum < list->count; ++moveNum) {
-        move = list->moves[moveNum].move;
-        if(!MakeMove(pos, move)) {
-            printf("In check");
-            continue;
-        }
+        move = list->moves[moveNum];
+        *child = *pos;
+        MakeMove(child, move);
         long cumnodes = leafNodes;
-        Perft(depth - 1, pos);
-        TakeMove(pos);
+        Perft(depth - 1, child);
         long oldnodes = leafNodes - cumnodes;
         printf("move %d : %s : %ld\n", moveNum + 1, PrMove(move), oldnodes);
     }
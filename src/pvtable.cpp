@@ -1,24 +1,35 @@
 #include "alo/types.hpp"
 #include <stdlib.h>
+#include <string.h>
 
-int GetPvLine(const int depth, Board *pos) {
+#include <thread>
+#include <vector>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Follows hash moves from pos on a scratch copy, so pos itself is untouched
+int GetPvLine(const int depth, const Board *pos, const S_HASHTABLE *table, int *pvArray) {
     ASSERT(depth < MAX_DEPTH && depth >= 1);
 
-    int move = ProbePvMove(pos);
+    Board line[1];
+    *line = *pos;
+    int move = ProbePvMove(line, table);
     int count = 0;
 
     while (move != NOMOVE && count < depth) {
-        if (MoveExists(pos, move)) {
-            MakeMove(pos, move);
-            pos->PvArray[count++] = move;
+        if (MoveExists(line, move)) {
+            MakeMove(line, move);
+            pvArray[count++] = move;
         } else {
             break;
         }
-        move = ProbePvMove(pos);
-    }
-
-    while (pos->ply > 0) {
-        TakeMove(pos);
+        move = ProbePvMove(line, table);
     }
 
     return count;
@@ -26,6 +37,20 @@ int GetPvLine(const int depth, Board *pos) {
 
 const int HashSize = 0x100000 * 256; // bytes
 
+// Entries store posKey ^ data, so an entry torn by a concurrent writer in
+// a shared table fails the key check instead of returning mixed data.
+static_assert(sizeof(S_HASHENTRY) == 2 * sizeof(U64), "hash entry must be two words");
+
+static inline U64 entryData(const S_HASHENTRY *entry) {
+    U64 data;
+    memcpy(&data, &entry->move, sizeof(data));
+    return data;
+}
+
+static inline U64 entryKey(const S_HASHENTRY *entry) {
+    return entry->posKey ^ entryData(entry);
+}
+
 void ClearHashTable(S_HASHTABLE *table) {
     for (int i = 0; i < table->numEntries; ++i) {
         table->pTable[i].posKey = 0ULL;
@@ -33,21 +58,49 @@ void ClearHashTable(S_HASHTABLE *table) {
         table->pTable[i].depth = 0;
         table->pTable[i].score = 0;
         table->pTable[i].flags = 0;
+        table->pTable[i].spare = 0;
     }
+    ResetHashStats(table);
+}
+
+void ResetHashStats(S_HASHTABLE *table) {
     table->newWrite = 0;
+    table->overWrite = 0;
+    table->probes = 0;
+    table->hits = 0;
+    table->cuts = 0;
+    table->collisions = 0;
+    table->skipWrite = 0;
+}
+
+// Permille of used entries, sampled over the first 1000 slots as UCI expects.
+int HashFull(const S_HASHTABLE *table) {
+    int samples = table->numEntries < 1000 ? table->numEntries : 1000;
+    int used = 0;
+    if (samples == 0) return 0;
+    for (int i = 0; i < samples; ++i) {
+        if (table->pTable[i].posKey != 0ULL) used++;
+    }
+    return used * 1000 / samples;
 }
 
 static int highestPowerOfTwo(int x);
+static void detachShared(S_HASHTABLE *table);
 
 static void freeTable(S_HASHTABLE* table) {
-    if (table && table->pTable) {
+    if (table->shared) {
+        detachShared(table);
+    } else if (table->pTable) {
         free(table->pTable);
-        table->pTable = NULL;
     }
+    table->pTable = NULL;
     table->numEntries = 0;
     table->mask = 0;
-    table->newWrite = 0;
-    table->overWrite = 0;
+    ResetHashStats(table);
+}
+
+void FreeHashTable(S_HASHTABLE *table) {
+    freeTable(table);
 }
 
 static int highestPowerOfTwo(int x) {
@@ -56,22 +109,34 @@ static int highestPowerOfTwo(int x) {
     return p;
 }
 
-void InitHashTable(S_HASHTABLE *table) {
-    int entries = HashSize / (int)sizeof(S_HASHENTRY);
-    table->numEntries = highestPowerOfTwo(entries);
+// Allocate a cache-line aligned table of entries (a power of two), uncleared.
+static int allocTable(S_HASHTABLE *table, int entries) {
+    table->numEntries = entries;
     table->mask = (U64)(table->numEntries - 1);
 
     void* mem = nullptr;
-    if (posix_memalign(&mem, 64, table->numEntries * sizeof(S_HASHENTRY)) != 0) {
-        mem = malloc(table->numEntries * sizeof(S_HASHENTRY));
+    if (posix_memalign(&mem, 64, (size_t)table->numEntries * sizeof(S_HASHENTRY)) != 0) {
+        mem = malloc((size_t)table->numEntries * sizeof(S_HASHENTRY));
     }
     table->pTable = (S_HASHENTRY*)mem;
     if (table->pTable == NULL) {
+        table->numEntries = 0;
+        table->mask = 0;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void InitHashTable(S_HASHTABLE *table) {
+    int entries = HashSize / (int)sizeof(S_HASHENTRY);
+    table->shared = NULL;
+    table->sharedBytes = 0;
+    table->sharedFd = -1;
+    table->sharedName[0] = 0;
+    if (!allocTable(table, highestPowerOfTwo(entries))) {
         #ifdef DEBUG
         printf("Hash Allocation Failed");
         #endif
-        table->numEntries = 0;
-        table->mask = 0;
         return;
     }
     ClearHashTable(table);
@@ -80,56 +145,338 @@ void InitHashTable(S_HASHTABLE *table) {
     #endif
 }
 
+// Replacement value used when several old entries fold onto one slot.
+static inline int entryValue(const S_HASHENTRY *entry) {
+    return entry->depth * 2 + (entry->flags == HFEXACT);
+}
+
+// Fill dst[begin, end) from src. Growing maps each slot back to its single
+// source slot; shrinking folds srcEntries / dstEntries slots together and
+// keeps the most valuable one.
+static void rehashRange(const S_HASHENTRY *src, int srcEntries, S_HASHENTRY *dst, int dstEntries, int begin, int end) {
+    const U64 dstMask = (U64)(dstEntries - 1);
+    for (int d = begin; d < end; ++d) {
+        S_HASHENTRY best;
+        memset(&best, 0, sizeof(best));
+        if (dstEntries >= srcEntries) {
+            const S_HASHENTRY *entry = &src[d & (srcEntries - 1)];
+            if (entry->posKey != 0ULL && (entryKey(entry) & dstMask) == (U64)d) {
+                best = *entry;
+            }
+        } else {
+            for (int index = d; index < srcEntries; index += dstEntries) {
+                const S_HASHENTRY *entry = &src[index];
+                if (entry->posKey != 0ULL && (best.posKey == 0ULL || entryValue(entry) > entryValue(&best))) {
+                    best = *entry;
+                }
+            }
+        }
+        dst[d] = best;
+    }
+}
+
 // Re-initialize hash table with a given size in megabytes.
-// Frees previous allocation (if any) and resizes.
+// Existing entries are rehashed into the new geometry; on allocation
+// failure the previous table is kept. A shared table is re-attached
+// instead, and only takes the new size if no other process holds it.
 void ReInitHashTable(S_HASHTABLE *table, int megabytes) {
     if (megabytes < 1) megabytes = 1;
-    int targetBytes = megabytes * 1024 * 1024;
-    freeTable(table);
-    int entries = targetBytes / (int)sizeof(S_HASHENTRY);
+    if (table->shared) {
+        char name[sizeof(table->sharedName)];
+        memcpy(name, table->sharedName, sizeof(name));
+        freeTable(table);
+        if (!AttachSharedHashTable(table, name, megabytes)) {
+            ReInitHashTable(table, megabytes);
+        }
+        return;
+    }
+    size_t targetBytes = (size_t)megabytes * 1024 * 1024;
+    size_t entries = targetBytes / sizeof(S_HASHENTRY);
     if (entries < 1) entries = 1;
-    table->numEntries = highestPowerOfTwo(entries);
-    table->mask = (U64)(table->numEntries - 1);
 
-    void* mem = nullptr;
-    if (posix_memalign(&mem, 64, table->numEntries * sizeof(S_HASHENTRY)) != 0) {
-        mem = malloc(table->numEntries * sizeof(S_HASHENTRY));
+    S_HASHTABLE next = *table;
+    if (!allocTable(&next, highestPowerOfTwo((int)entries))) {
+        return;
     }
-    table->pTable = (S_HASHENTRY*)mem;
-    if (table->pTable == NULL) {
-        table->numEntries = 0;
-        table->mask = 0;
+
+    if (table->pTable == NULL || table->numEntries == 0) {
+        *table = next;
+        ClearHashTable(table);
         return;
     }
-    ClearHashTable(table);
+
+    int workers = (int)std::thread::hardware_concurrency();
+    if (workers < 1) workers = 1;
+    if (workers > 8) workers = 8;
+    if (next.numEntries < (1 << 16)) workers = 1;
+
+    std::vector<std::thread> pool;
+    int chunk = next.numEntries / workers;
+    for (int w = 0; w < workers; ++w) {
+        int begin = w * chunk;
+        int end = (w == workers - 1) ? next.numEntries : begin + chunk;
+        pool.emplace_back(rehashRange, table->pTable, table->numEntries, next.pTable, next.numEntries, begin, end);
+    }
+    for (std::thread &t : pool) {
+        t.join();
+    }
+
+    freeTable(table);
+    *table = next;
+    ResetHashStats(table);
+}
+
+// On-disk layout: this header followed by numEntries raw entries.
+typedef struct {
+    char magic[8];
+    int version;
+    int entrySize;
+    int numEntries;
+    int reserved;
+    U64 keyFingerprint;
+} S_HASHFILEHEADER;
+
+static const char HashFileMagic[8] = "ALOHASH";
+static const int HashFileVersion = 3;
+
+int SaveHashTable(const S_HASHTABLE *table, const char *path) {
+    if (table->pTable == NULL || table->numEntries == 0) return FALSE;
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) return FALSE;
+
+    S_HASHFILEHEADER header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, HashFileMagic, sizeof(header.magic));
+    header.version = HashFileVersion;
+    header.entrySize = (int)sizeof(S_HASHENTRY);
+    header.numEntries = table->numEntries;
+    header.keyFingerprint = HashKeyFingerprint();
+
+    size_t count = (size_t)table->numEntries;
+    int ok = fwrite(&header, sizeof(header), 1, f) == 1
+          && fwrite(table->pTable, sizeof(S_HASHENTRY), count, f) == count;
+    if (fclose(f) != 0) ok = FALSE;
+    return ok ? TRUE : FALSE;
+}
+
+// Replace the table with the one stored at path, adopting its geometry.
+// The file is mapped read-only and copied; on any mismatch the current
+// table is left untouched.
+int LoadHashTable(S_HASHTABLE *table, const char *path) {
+#ifdef WIN32
+    (void)table; (void)path;
+    return FALSE;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return FALSE;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(S_HASHFILEHEADER)) {
+        close(fd);
+        return FALSE;
+    }
+
+    size_t length = (size_t)st.st_size;
+    void *map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return FALSE;
+
+    const S_HASHFILEHEADER *header = (const S_HASHFILEHEADER *)map;
+    int ok = memcmp(header->magic, HashFileMagic, sizeof(header->magic)) == 0
+          && header->version == HashFileVersion
+          && header->entrySize == (int)sizeof(S_HASHENTRY)
+          && header->keyFingerprint == HashKeyFingerprint()
+          && header->numEntries > 0
+          && highestPowerOfTwo(header->numEntries) == header->numEntries
+          && length == sizeof(S_HASHFILEHEADER) + (size_t)header->numEntries * sizeof(S_HASHENTRY);
+
+    if (ok && header->numEntries != table->numEntries) {
+        if (table->shared) {
+            ok = FALSE; // the segment's geometry is fixed by its creator
+        } else {
+            S_HASHTABLE next = *table;
+            ok = allocTable(&next, header->numEntries);
+            if (ok) {
+                freeTable(table);
+                *table = next;
+            }
+        }
+    }
+    if (ok) {
+        madvise(map, length, MADV_SEQUENTIAL);
+        memcpy(table->pTable, (const char *)map + sizeof(S_HASHFILEHEADER),
+               (size_t)table->numEntries * sizeof(S_HASHENTRY));
+        ResetHashStats(table);
+    }
+
+    munmap(map, length);
+    return ok ? TRUE : FALSE;
+#endif
+}
+
+// Header at the start of a shared segment, followed by numEntries entries.
+// Attach and detach hold an flock on the segment, so refCount is only
+// touched under the lock.
+typedef struct {
+    char magic[8];
+    int version;
+    int entrySize;
+    int numEntries;
+    int refCount;
+    U64 keyFingerprint;
+    char pad[32];
+} S_SHAREDHASHHEADER;
+
+static const char SharedHashMagic[8] = "ALOSHM";
+static const int SharedHashVersion = 2;
+
+// Attach table to the named segment, creating it with the given size if
+// no process holds it yet. An existing segment keeps its own geometry.
+// The private table is released only once the attach has succeeded.
+int AttachSharedHashTable(S_HASHTABLE *table, const char *name, int megabytes) {
+#ifdef WIN32
+    (void)table; (void)name; (void)megabytes;
+    return FALSE;
+#else
+    if (name == NULL || *name != '/' || strlen(name) >= sizeof(table->sharedName)) return FALSE;
+    if (megabytes < 1) megabytes = 1;
+
+    for (int attempt = 0; attempt < 8; ++attempt) {
+        int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+        if (fd < 0) return FALSE;
+        if (flock(fd, LOCK_EX) != 0) {
+            close(fd);
+            return FALSE;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            flock(fd, LOCK_UN);
+            close(fd);
+            return FALSE;
+        }
+
+        size_t bytes;
+        int created = st.st_size == 0;
+        if (created) {
+            size_t entries = ((size_t)megabytes * 1024 * 1024) / sizeof(S_HASHENTRY);
+            if (entries < 1) entries = 1;
+            bytes = sizeof(S_SHAREDHASHHEADER) + (size_t)highestPowerOfTwo((int)entries) * sizeof(S_HASHENTRY);
+            if (ftruncate(fd, (off_t)bytes) != 0) {
+                shm_unlink(name);
+                flock(fd, LOCK_UN);
+                close(fd);
+                return FALSE;
+            }
+        } else {
+            bytes = (size_t)st.st_size;
+        }
+
+        void *map = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            if (created) shm_unlink(name);
+            flock(fd, LOCK_UN);
+            close(fd);
+            return FALSE;
+        }
+
+        S_SHAREDHASHHEADER *header = (S_SHAREDHASHHEADER *)map;
+        if (created) {
+            // ftruncate zero-filled the entries, which is an empty table
+            memcpy(header->magic, SharedHashMagic, sizeof(header->magic));
+            header->version = SharedHashVersion;
+            header->entrySize = (int)sizeof(S_HASHENTRY);
+            header->numEntries = (int)((bytes - sizeof(S_SHAREDHASHHEADER)) / sizeof(S_HASHENTRY));
+            header->keyFingerprint = HashKeyFingerprint();
+            header->refCount = 0;
+        } else if (header->refCount == 0) {
+            // Last holder detached and unlinked it while we waited; retry
+            munmap(map, bytes);
+            flock(fd, LOCK_UN);
+            close(fd);
+            continue;
+        }
+
+        int ok = memcmp(header->magic, SharedHashMagic, sizeof(header->magic)) == 0
+              && header->version == SharedHashVersion
+              && header->entrySize == (int)sizeof(S_HASHENTRY)
+              && header->keyFingerprint == HashKeyFingerprint()
+              && bytes == sizeof(S_SHAREDHASHHEADER) + (size_t)header->numEntries * sizeof(S_HASHENTRY);
+        if (!ok) {
+            munmap(map, bytes);
+            flock(fd, LOCK_UN);
+            close(fd);
+            return FALSE;
+        }
+
+        header->refCount++;
+        flock(fd, LOCK_UN);
+
+        freeTable(table);
+        table->shared = map;
+        table->sharedBytes = bytes;
+        table->sharedFd = fd;
+        strcpy(table->sharedName, name);
+        table->pTable = (S_HASHENTRY *)((char *)map + sizeof(S_SHAREDHASHHEADER));
+        table->numEntries = header->numEntries;
+        table->mask = (U64)(table->numEntries - 1);
+        ResetHashStats(table);
+        return TRUE;
+    }
+    return FALSE;
+#endif
+}
+
+// Drop our reference; the last process to leave removes the segment.
+static void detachShared(S_HASHTABLE *table) {
+#ifndef WIN32
+    S_SHAREDHASHHEADER *header = (S_SHAREDHASHHEADER *)table->shared;
+    flock(table->sharedFd, LOCK_EX);
+    if (--header->refCount == 0) {
+        shm_unlink(table->sharedName);
+    }
+    flock(table->sharedFd, LOCK_UN);
+    munmap(table->shared, table->sharedBytes);
+    close(table->sharedFd);
+#endif
+    table->shared = NULL;
+    table->sharedBytes = 0;
+    table->sharedFd = -1;
+    table->sharedName[0] = 0;
 }
 
-int ProbeHashEntry(Board *pos, int *move, int *score, int alpha, int beta, int depth) {
-    U64 index = pos->posKey & pos->HashTable->mask;
-    __builtin_prefetch(&pos->HashTable->pTable[index]);
-    if (pos->HashTable->pTable[index].posKey == pos->posKey) {
-        *move = pos->HashTable->pTable[index].move;
-        if (pos->HashTable->pTable[index].depth >= depth) {
-            *score = (int)pos->HashTable->pTable[index].score;
+int ProbeHashEntry(S_HASHTABLE *table, const Board *pos, int *move, int *score, int alpha, int beta, int depth) {
+    U64 index = pos->posKey & table->mask;
+    S_HASHENTRY entry = table->pTable[index];
+    table->probes++;
+    if (entryKey(&entry) == pos->posKey) {
+        table->hits++;
+        *move = entry.move;
+        if (entry.depth >= depth) {
+            *score = (int)entry.score;
             if (*score > ISMATE) {
                 *score -= pos->ply;
             } else if (*score < -ISMATE) {
                 *score += pos->ply;
             }
-            switch (pos->HashTable->pTable[index].flags) {
+            switch (entry.flags) {
             case HFALPHA:
                 if (*score <= alpha) {
                     *score = alpha;
+                    table->cuts++;
                     return TRUE;
                 }
                 break;
             case HFBETA:
                 if (*score >= beta) {
                     *score = beta;
+                    table->cuts++;
                     return TRUE;
                 }
                 break;
             case HFEXACT:
+                table->cuts++;
                 return TRUE;
                 break;
             default:
@@ -137,20 +484,24 @@ int ProbeHashEntry(Board *pos, int *move, int *score, int alpha, int beta, int d
                 break;
             }
         }
+    } else if (entry.posKey != 0ULL) {
+        table->collisions++;
     }
     return FALSE;
 }
 
-void StoreHashEntry(Board *pos, const int move, int score, const int flags, const int depth) {
-    U64 index = pos->posKey & pos->HashTable->mask;
-    if (pos->HashTable->pTable[index].posKey == 0) {
-        pos->HashTable->newWrite++;
+void StoreHashEntry(S_HASHTABLE *table, const Board *pos, const int move, int score, const int flags, const int depth) {
+    U64 index = pos->posKey & table->mask;
+    S_HASHENTRY entry = table->pTable[index];
+    if (entry.posKey == 0) {
+        table->newWrite++;
     } else {
         //Ignore if new depth is lower than previous one
-        if(pos->HashTable->pTable[index].depth > depth) {
+        if(entry.depth > depth) {
+            table->skipWrite++;
             return;
         }
-        pos->HashTable->overWrite++;
+        table->overWrite++;
     }
 
     if (score > ISMATE) {
@@ -159,20 +510,22 @@ void StoreHashEntry(Board *pos, const int move, int score, const int flags, cons
         score -= pos->ply;
     }
 
-    pos->HashTable->pTable[index].move = move;
-    pos->HashTable->pTable[index].posKey = pos->posKey;
-    pos->HashTable->pTable[index].flags = flags;
+    entry.move = move;
+    entry.flags = flags;
     if (score > 32767) score = 32767; else if (score < -32768) score = -32768;
-    pos->HashTable->pTable[index].score = (short)score;
-    pos->HashTable->pTable[index].depth = depth;
+    entry.score = (short)score;
+    entry.depth = depth;
+    entry.posKey = pos->posKey ^ entryData(&entry);
+    table->pTable[index] = entry;
 }
 
-int ProbePvMove(const Board *pos) {
-    U64 index = pos->posKey & pos->HashTable->mask;
-    ASSERT(index >= 0 && index <= pos->HashTable->numEntries - 1);
+int ProbePvMove(const Board *pos, const S_HASHTABLE *table) {
+    U64 index = pos->posKey & table->mask;
+    ASSERT(index >= 0 && index <= table->numEntries - 1);
 
-    if (pos->HashTable->pTable[index].posKey == pos->posKey) {
-        return pos->HashTable->pTable[index].move;
+    S_HASHENTRY entry = table->pTable[index];
+    if (entryKey(&entry) == pos->posKey) {
+        return entry.move;
     }
 
     return NOMOVE;
@@ -6,7 +6,7 @@
 #define MATE 29000
 
 namespace alo {
-Searcher::Searcher(Board* p, SearchInfo* i) : pos(p), info(i), tt(p->HashTable) {}
+Searcher::Searcher(Board* p, SearchInfo* i, SearchData* d) : root(p), info(i), data(d), tt(d->HashTable) {}
 } // namespace alo
 
 void alo::Searcher::checkUp() {
@@ -16,11 +16,47 @@ void alo::Searcher::checkUp() {
     ReadInput(info);
 }
 
-int IsRepetition(const Board *pos) {
+// Plies back to the last irreversible move or null move, whichever is
+// nearer; a line through a null move is not a game path
+static inline int RepetitionHorizon(const Board *pos) {
+    return pos->fiftyMove < pos->pliesFromNull ? pos->fiftyMove : pos->pliesFromNull;
+}
+
+// Only plies with the same side to move can repeat. Most positions never
+// appear on the path, and the key filter rejects those without a scan.
+int IsRepetition(const Board *pos, const SearchData *data) {
     int index = 0;
-    for (index = pos->hisPly - pos->fiftyMove; index < pos->hisPly - 1; ++index) {
+    if (!data->keyFilter[pos->posKey & (KEY_FILTER_SIZE - 1)]) {
+        return FALSE;
+    }
+    for (index = pos->hisPly - 2; index >= pos->hisPly - RepetitionHorizon(pos); index -= 2) {
         ASSERT(index >= 0 && index < MAX_GAME_MOVES);
-        if (pos->posKey == pos->history[index].posKey) {
+        if (pos->posKey == data->gameKeys[index]) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+// Upcoming repetition: one reversible move from here reaches a position
+// already on the search path, so the side to move can force a draw.
+int HasGameCycle(const Board *pos, const SearchData *data) {
+    int index = 0;
+    const int horizon = RepetitionHorizon(pos);
+    if (horizon < 3) {
+        return FALSE;
+    }
+    for (index = 3; index <= horizon && index <= pos->ply; index += 2) {
+        const U64 moveKey = pos->posKey ^ data->gameKeys[pos->hisPly - index];
+        int slot = CUCKOO_H1(moveKey);
+        if (CuckooKeys[slot] != moveKey) {
+            slot = CUCKOO_H2(moveKey);
+            if (CuckooKeys[slot] != moveKey) {
+                continue;
+            }
+        }
+        const int move = CuckooMoves[slot];
+        if (!(BetweenBB[FROM64(move)][TO64(move)] & pos->occBB[BOTH])) {
             return TRUE;
         }
     }
@@ -28,22 +64,60 @@ int IsRepetition(const Board *pos) {
 }
 
 void alo::Searcher::pickNextMove(int moveNum, MoveList *list) {
-    S_MOVE temp;
     int index = 0;
     int bestScore = 0;
     int bestNum = moveNum;
     for (index = moveNum; index < list->count; ++index) {
-        if (list->moves[index].score > bestScore) {
-            bestScore = list->moves[index].score;
+        if (list->scores[index] > bestScore) {
+            bestScore = list->scores[index];
             bestNum = index;
         }
     }
     ASSERT(moveNum >= 0 && moveNum < list->count);
     ASSERT(bestNum >= 0 && bestNum < list->count);
     ASSERT(bestNum >= moveNum);
-    temp = list->moves[moveNum];
+    unsigned short move = list->moves[moveNum];
+    int score = list->scores[moveNum];
     list->moves[moveNum] = list->moves[bestNum];
-    list->moves[bestNum] = temp;
+    list->scores[moveNum] = list->scores[bestNum];
+    list->moves[bestNum] = move;
+    list->scores[bestNum] = score;
+}
+
+// Quiet moves are ordered by killers, then history; the generator only
+// scores captures and promotions
+void alo::Searcher::scoreQuiets(const Board *pos, MoveList *list, int first) {
+    for (int index = first; index < list->count; ++index) {
+        const int move = list->moves[index];
+        if (move & (MFLAGCAP | MFLAGPROM)) {
+            continue;
+        }
+        if (data->searchKillers[0][pos->ply] == move) {
+            list->scores[index] = 900000;
+        } else if (data->searchKillers[1][pos->ply] == move) {
+            list->scores[index] = 800000;
+        } else {
+            list->scores[index] = data->searchHistory[pos->pieces[FROMSQ(move)]][TOSQ(move)];
+        }
+    }
+}
+
+// Copy-make: the parent is never modified, so nothing has to be undone.
+// The parent's key is recorded for repetition checks below the child and
+// stays in the key filter until leaveChild.
+void alo::Searcher::makeChild(const Board *pos, Board *child, int move) {
+    data->gameKeys[pos->hisPly] = pos->posKey;
+    data->keyFilter[pos->posKey & (KEY_FILTER_SIZE - 1)]++;
+    *child = *pos;
+    if (move == NOMOVE) {
+        MakeNullMove(child);
+    } else {
+        MakeMove(child, move);
+    }
+}
+
+void alo::Searcher::leaveChild(const Board *pos) {
+    data->keyFilter[pos->posKey & (KEY_FILTER_SIZE - 1)]--;
 }
 
 void alo::Searcher::clearForSearch() {
@@ -51,17 +125,25 @@ void alo::Searcher::clearForSearch() {
     int index2 = 0;
     for (index = 0; index < 13; ++index) {
         for (index2 = 0; index2 < BOARD_SIZE; ++index2) {
-            pos->searchHistory[index][index2] = 0;
+            data->searchHistory[index][index2] = 0;
         }
     }
     for (index = 0; index < 2; ++index) {
         for (index2 = 0; index2 < MAX_DEPTH; ++index2) {
-            pos->searchKillers[index][index2] = 0;
+            data->searchKillers[index][index2] = 0;
         }
     }
 
-    pos->HashTable->overWrite = 0;
-    pos->ply = 0;
+    // The filter starts from the game keys that can still repeat
+    for (index = 0; index < KEY_FILTER_SIZE; ++index) {
+        data->keyFilter[index] = 0;
+    }
+    for (index = root->hisPly - root->fiftyMove; index < root->hisPly; ++index) {
+        data->keyFilter[data->gameKeys[index] & (KEY_FILTER_SIZE - 1)]++;
+    }
+
+    tt.resetStats();
+    root->ply = 0;
 
     info->stopped = 0;
     info->nodes = 0;
@@ -70,28 +152,52 @@ void alo::Searcher::clearForSearch() {
     info->fhf = 0;
 }
 
-int alo::Searcher::quiescence(int alpha, int beta) {
+// depth is 0 at the first quiescence ply, where quiet checks are searched
+// too, and negative below it
+int alo::Searcher::quiescence(Board *pos, int alpha, int beta, int depth) {
     ASSERT(CheckBoard(pos));
     if ((info->nodes & 2047) == 0) {
         checkUp();
     }
     info->nodes++;
-    if ((IsRepetition(pos) || pos->fiftyMove >= 100) && pos->ply) {
+    if ((IsRepetition(pos, data) || pos->fiftyMove >= 100) && pos->ply) {
         return 0;
     }
     if (pos->ply > MAX_DEPTH - 1) {
         return EvaluatePosition(pos);
     }
-    int score = EvaluatePosition(pos);
-    if (score >= beta) {
-        return beta;
-    }
-    if (score > alpha) {
-        alpha = score;
-    }
+
+    // Reads the attack map if the node has one; the full evaluation builds it
+    int inCheck = InCheck(pos, data->evalTables);
+    int score = -SCORE_INF;
 
     MoveList list[1];
-    GenerateAllCaptures(pos, list);
+    if (inCheck) {
+        // No standing pat in check: every evasion is searched so mates are seen
+        GenerateEvasions(pos, list);
+        if (list->count == 0) {
+            return -MATE + pos->ply;
+        }
+    } else {
+        score = EvaluateInWindow(pos, data->evalTables, alpha, beta);
+        if (score >= beta) {
+            return beta;
+        }
+        if (score > alpha) {
+            alpha = score;
+        }
+
+        GenerateAllCaptures(pos, list);
+        if (depth == 0) {
+            MoveList checks[1];
+            GenerateQuietChecks(pos, checks);
+            scoreQuiets(pos, checks, 0);
+            for (int index = 0; index < checks->count; ++index) {
+                list->moves[list->count] = checks->moves[index];
+                list->scores[list->count++] = checks->scores[index];
+            }
+        }
+    }
 
     int MoveNum = 0;
     int Legal = 0;
@@ -99,14 +205,13 @@ int alo::Searcher::quiescence(int alpha, int beta) {
     int BestMove = NOMOVE;
     int BestScore = -SCORE_INF;
     score = -SCORE_INF;
+    Board child[1];
     for (MoveNum = 0; MoveNum < list->count; ++MoveNum) {
         pickNextMove(MoveNum, list);
-        if (!MakeMove(pos, list->moves[MoveNum].move)) {
-            continue;
-        }
+        makeChild(pos, child, list->moves[MoveNum]);
         Legal++;
-        score = -quiescence(-beta, -alpha);
-        TakeMove(pos);
+        score = -quiescence(child, -beta, -alpha, depth - 1);
+        leaveChild(pos);
         if (info->stopped == TRUE) {
             return 0;
         }
@@ -115,17 +220,17 @@ int alo::Searcher::quiescence(int alpha, int beta) {
                 return beta;
             }
             alpha = score;
-            BestMove = list->moves[MoveNum].move;
+            BestMove = list->moves[MoveNum];
         }
     }
 
     return alpha;
 }
 
-int alo::Searcher::alphaBeta(int alpha, int beta, int depth, int DoNull) {
+int alo::Searcher::alphaBeta(Board *pos, int alpha, int beta, int depth, int DoNull) {
     ASSERT(CheckBoard(pos));
     if (depth == 0) {
-        return quiescence(alpha, beta);
+        return quiescence(pos, alpha, beta, 0);
     }
 
     if ((info->nodes & 2047) == 0) {
@@ -134,15 +239,23 @@ int alo::Searcher::alphaBeta(int alpha, int beta, int depth, int DoNull) {
 
     info->nodes++;
 
-    if ((IsRepetition(pos) || pos->fiftyMove >= 100) && pos->ply) {
+    if ((IsRepetition(pos, data) || pos->fiftyMove >= 100) && pos->ply) {
         return 0;
     }
 
+    // A draw is already in reach, so it is a lower bound on the score
+    if (pos->ply && alpha < 0 && HasGameCycle(pos, data)) {
+        alpha = 0;
+        if (alpha >= beta) {
+            return alpha;
+        }
+    }
+
     if (pos->ply > MAX_DEPTH - 1) {
         return EvaluatePosition(pos);
     }
 
-    int inCheck = SqAttacked(pos->kingSq[pos->side], pos->side ^ 1, pos);
+    int inCheck = InCheck(pos, data->evalTables);
 
     if (inCheck) {
         depth++;
@@ -155,11 +268,13 @@ int alo::Searcher::alphaBeta(int alpha, int beta, int depth, int DoNull) {
         return score;
     }
 
+    Board child[1];
+
     //Null Move Pruning
     if (DoNull && !inCheck && pos->ply && (pos->bigPce[pos->side] > 0) && depth >= 6) {
-        MakeNullMove(pos);
-        score = -alphaBeta(-beta, -beta + 1, depth - 6, FALSE);
-        TakeNullMove(pos);
+        makeChild(pos, child, NOMOVE);
+        score = -alphaBeta(child, -beta, -beta + 1, depth - 6, FALSE);
+        leaveChild(pos);
         if (info->stopped == TRUE) {
             return 0;
         }
@@ -170,7 +285,12 @@ int alo::Searcher::alphaBeta(int alpha, int beta, int depth, int DoNull) {
 
 
     MoveList list[1];
-    GenerateAllMoves(pos, list);
+    if (inCheck) {
+        GenerateEvasions(pos, list);
+    } else {
+        GenerateAllMoves(pos, list);
+    }
+    scoreQuiets(pos, list, 0);
 
     int MoveNum = 0;
     int Legal = 0;
@@ -183,47 +303,59 @@ int alo::Searcher::alphaBeta(int alpha, int beta, int depth, int DoNull) {
     //PvMoves priority & ordering
     if(PvMove != NOMOVE) {
         for(MoveNum = 0; MoveNum < list->count; ++MoveNum) {
-            if(list->moves[MoveNum].move == PvMove) {
-                list->moves[MoveNum].score = 2000000;
+            if(list->moves[MoveNum] == PvMove) {
+                list->scores[MoveNum] = 2000000;
                 break;
             }
         }
     }
 
+    // Only nodes that may reduce need to know which moves check
+    S_CHECKSQ checkSq[1];
+    const int mayReduce = depth >= 3 && !inCheck;
+    if (mayReduce) {
+        InitCheckSquares(pos, checkSq);
+    }
+
     for (MoveNum = 0; MoveNum < list->count; ++MoveNum) {
         pickNextMove(MoveNum, list);
-        if (!MakeMove(pos, list->moves[MoveNum].move)) {
-            continue;
-        }
+        const int move = list->moves[MoveNum];
 
-        Legal++;
-        int score;
-
-        // Late Move Reductions: reduce depth for late, non-capture, non-check moves
+        // Late Move Reductions: reduce depth for late, non-capture, non-check moves.
+        // Decided before MakeMove, while the check squares still describe the board.
         int reduction = 0;
-        if (depth >= 3 && MoveNum > 3 && !(list->moves[MoveNum].move & (MFLAGCAP | MFLAGPROM)) && !inCheck) {
+        if (mayReduce && MoveNum > 3 && !(move & (MFLAGCAP | MFLAGPROM)) && !GivesCheck(pos, checkSq, move)) {
             reduction = 1;
         }
 
-        score = -alphaBeta(-beta, -alpha, depth - 1 - reduction, TRUE);
+        // Children at depth 0 drop straight into quiescence and never probe
+        if (depth > 1) {
+            tt.prefetch(KeyAfterMove(pos, move));
+        }
+        makeChild(pos, child, move);
+
+        Legal++;
+        int score;
+
+        score = -alphaBeta(child, -beta, -alpha, depth - 1 - reduction, TRUE);
 
         // If reduced and improved, re-search at full depth
         if (reduction && score > alpha) {
-            score = -alphaBeta(-beta, -alpha, depth - 1, TRUE);
+            score = -alphaBeta(child, -beta, -alpha, depth - 1, TRUE);
         }
+        leaveChild(pos);
 
-        TakeMove(pos);
         if (info->stopped == TRUE) {
             return 0;
         }
         if (score > BestScore) {
             BestScore = score;
-            BestMove = list->moves[MoveNum].move;
+            BestMove = list->moves[MoveNum];
             if (score > alpha) {
                 if (score >= beta) {
-                    if (!(list->moves[MoveNum].move & MFLAGCAP)) {
-                        pos->searchKillers[1][pos->ply] = pos->searchKillers[0][pos->ply];
-                        pos->searchKillers[0][pos->ply] = list->moves[MoveNum].move;
+                    if (!(move & MFLAGCAP)) {
+                        data->searchKillers[1][pos->ply] = data->searchKillers[0][pos->ply];
+                        data->searchKillers[0][pos->ply] = move;
                     }
 
                     tt.store(pos, BestMove, beta, HFBETA, depth);
@@ -255,7 +387,7 @@ int alo::Searcher::alphaBeta(int alpha, int beta, int depth, int DoNull) {
 }
 
 int alo::Searcher::searchScore(int depth, int time_ms) {
-    ASSERT(CheckBoard(pos));
+    ASSERT(CheckBoard(root));
 
     // Configure SearchInfo
     info->depth   = depth;
@@ -277,7 +409,7 @@ int alo::Searcher::searchScore(int depth, int time_ms) {
     clearForSearch();
 
     // One call, no iterative deepening, no printing
-    int score = alphaBeta(-SCORE_INF, SCORE_INF, depth, TRUE);
+    int score = alphaBeta(root, -SCORE_INF, SCORE_INF, depth, TRUE);
     return score;
 }
 
@@ -291,14 +423,14 @@ void alo::Searcher::searchPosition() {
     clearForSearch();
 
     for (currentDepth = 1; currentDepth <= info->depth; ++currentDepth) {
-        bestScore = alphaBeta(-SCORE_INF, SCORE_INF, currentDepth, TRUE);
+        bestScore = alphaBeta(root, -SCORE_INF, SCORE_INF, currentDepth, TRUE);
 
         if (info->stopped == TRUE) {
             break;
         }
 
-        pvMoves = tt.getPvLine(currentDepth, pos);
-        bestMove = pos->PvArray[0];
+        pvMoves = tt.getPvLine(currentDepth, root, data->PvArray);
+        bestMove = data->PvArray[0];
         int elapsed = GetTimeMS() - info->startTime;
         if (elapsed < 1) elapsed = 1;
         int nps = (int)(info->nodes / (elapsed / 1000.0));
@@ -308,22 +440,29 @@ void alo::Searcher::searchPosition() {
         } else {
             printf("info score cp %d depth %d nodes %ld time %d nps %d ", bestScore, currentDepth, info->nodes, elapsed, nps);
         }
+        printf("hashfull %d ", tt.hashFull());
         printf("pv");
         for (pvNum = 0; pvNum < pvMoves; ++pvNum) {
-            printf(" %s", PrMove(pos->PvArray[pvNum]));
+            printf(" %s", PrMove(data->PvArray[pvNum]));
         }
         printf("\n");
     }
+
+    const S_HASHTABLE *table = tt.raw();
+    long probes = table->probes > 0 ? table->probes : 1;
+    printf("info string tt probes %ld hit %.1f%% cut %.1f%% collisions %ld new %d over %d skip %ld\n",
+           table->probes, 100.0 * table->hits / probes, 100.0 * table->cuts / probes, table->collisions,
+           table->newWrite, table->overWrite, table->skipWrite);
     printf("bestmove %s\n", PrMove(bestMove));
 }
 
 // Free function keeps API stable
-void SearchPosition(Board *pos, SearchInfo *info) {
-    alo::Searcher s(pos, info);
+void SearchPosition(Board *pos, SearchInfo *info, SearchData *data) {
+    alo::Searcher s(pos, info, data);
     s.searchPosition();
 }
 
-int SearchScore(Board *pos, SearchInfo *info, int depth, int time_ms) {
-    alo::Searcher s(pos, info);
+int SearchScore(Board *pos, SearchInfo *info, SearchData *data, int depth, int time_ms) {
+    alo::Searcher s(pos, info, data);
     return s.searchScore(depth, time_ms);
 }
\ No newline at end of file
@@ -5,9 +5,17 @@
 
 #define INPUTBUFFER 400 * 6
 
+// Argument following a command word, with surrounding whitespace removed.
+static char *commandArg(char *line, size_t cmdLen) {
+    char *arg = line + cmdLen;
+    while(*arg == ' ') arg++;
+    char *nl = strpbrk(arg, "\r\n"); if(nl) *nl = 0;
+    return arg;
+}
+
 // Minimal UCI class wrapper to structure logic
 namespace alo {
-void Uci::parseGo(char *line, SearchInfo *info, Board *pos) {
+void Uci::parseGo(char *line, SearchInfo *info, Board *pos, SearchData *data) {
         int depth = -1, movestogo = 50, movetime = -1;
         int time = -1, inc = 0;
         char *ptr = NULL;
@@ -35,10 +43,10 @@ void Uci::parseGo(char *line, SearchInfo *info, Board *pos) {
             info->stopTime = info->startTime + time + inc/2;
         }
         if(depth == -1) info->depth = MAX_DEPTH;
-        SearchPosition(pos, info);
+        SearchPosition(pos, info, data);
 }
 
-void Uci::parsePosition(const char *lineIn, Board *pos) {
+void Uci::parsePosition(const char *lineIn, Board *pos, SearchData *data) {
         lineIn += 9;
         const char *ptrChar = lineIn;
         if(strncmp(lineIn, "startpos", 8) == 0) {
@@ -60,7 +68,7 @@ void Uci::parsePosition(const char *lineIn, Board *pos) {
             while(*ptrChar) {
                 move = ParseMove(ptrChar, pos);
                 if(move == NOMOVE) break;
-                MakeMove(pos, move);
+                MakeGameMove(pos, data, move);
                 pos->ply = 0;
                 while(*ptrChar && *ptrChar != ' ') ptrChar++;
                 ptrChar++;
@@ -76,7 +84,11 @@ void Uci::loop() {
 
         Board pos[1];
         SearchInfo info[1];
-        InitHashTable(pos->HashTable);
+        SearchData data[1];
+        memset(info, 0, sizeof(SearchInfo));
+        InitHashTable(data->HashTable);
+        ClearEvalTables(data->evalTables);
+        char sharedHashName[64] = "/alo_hash";
 
         while(TRUE) {
             memset(&line[0], 0, sizeof(line));
@@ -104,26 +116,45 @@ void Uci::loop() {
                     } else {
                         strncpy(nameBuf, pName, sizeof(nameBuf)-1);
                     } 
-                    if(!strncmp(nameBuf, "Hash", 4)) {
+                    if(!strncmp(nameBuf, "Shared Hash Name", 16)) {
+                        if(pValue) {
+                            char *name = commandArg(pValue, 0);
+                            snprintf(sharedHashName, sizeof(sharedHashName), "%s", name);
+                        }
+                    } else if(!strncmp(nameBuf, "Shared Hash", 11)) {
+                        int enable = pValue && !strncmp(pValue, "true", 4);
+                        int mb = (int)(((size_t)data->HashTable->numEntries * sizeof(S_HASHENTRY)) >> 20);
+                        if(enable && !data->HashTable->shared) {
+                            if(AttachSharedHashTable(data->HashTable, sharedHashName, mb)) {
+                                printf("info string attached shared hash %s (%d entries)\n", sharedHashName, data->HashTable->numEntries);
+                            } else {
+                                printf("info string could not attach shared hash %s\n", sharedHashName);
+                            }
+                        } else if(!enable && data->HashTable->shared) {
+                            FreeHashTable(data->HashTable);
+                            ReInitHashTable(data->HashTable, mb);
+                        }
+                    } else if(!strncmp(nameBuf, "Hash", 4)) {
                         if(pValue) {
                             int mb = atoi(pValue);
                             if (mb < 1) mb = 1; if (mb > 4096) mb = 4096;
-                            ReInitHashTable(pos->HashTable, mb);
+                            ReInitHashTable(data->HashTable, mb);
                         }
                     } else if(!strncmp(nameBuf, "Clear Hash", 10)) {
-                        ClearHashTable(pos->HashTable);
+                        ClearHashTable(data->HashTable);
                     } else if(!strncmp(nameBuf, "Threads", 7)) {
                         // single-threaded for now; ignore
                     }
                 }
                 continue;
             } else if(!strncmp(line, "position", 8)) {
-                parsePosition(line, pos);
+                parsePosition(line, pos, data);
             } else if(!strncmp(line, "ucinewgame", 10)) {
-                parsePosition("position startpos\n", pos);
-                ClearHashTable(pos->HashTable);
+                parsePosition("position startpos\n", pos, data);
+                // A shared table also serves other processes' games
+                if(!data->HashTable->shared) ClearHashTable(data->HashTable);
             } else if(!strncmp(line, "go", 2)) {
-                parseGo(line, info, pos);
+                parseGo(line, info, pos, data);
             } else if(!strncmp(line, "quit", 4)) {
                 info->quit = TRUE; break;
             } else if(!strncmp(line, "uci", 3)) {
@@ -131,21 +162,38 @@ void Uci::loop() {
                 printf("id author %s\n", "Aloden");
                 printf("option name Hash type spin default 256 min 1 max 4096\n");
                 printf("option name Clear Hash type button\n");
+                printf("option name Shared Hash type check default false\n");
+                printf("option name Shared Hash Name type string default /alo_hash\n");
                 printf("option name Threads type spin default 1 min 1 max 1\n");
                 printf("uciok\n");
             } else if(!strncmp(line, "test", 4)) {
                 PrintBitBoard(PawnShield[0]);
             } else if(!strncmp(line, "evaluate", 7)) {
                 printf("Eval:%d\n", EvaluatePosition(pos));
+            } else if(!strncmp(line, "savehash", 8)) {
+                char *path = commandArg(line, 8);
+                if(*path && SaveHashTable(data->HashTable, path)) {
+                    printf("info string hash saved to %s\n", path);
+                } else {
+                    printf("info string could not save hash to %s\n", path);
+                }
+            } else if(!strncmp(line, "loadhash", 8)) {
+                char *path = commandArg(line, 8);
+                if(*path && LoadHashTable(data->HashTable, path)) {
+                    printf("info string hash loaded from %s (%d entries)\n", path, data->HashTable->numEntries);
+                } else {
+                    printf("info string could not load hash from %s\n", path);
+                }
             }
             if(info->quit) break;
         }
+        FreeHashTable(data->HashTable);
 }
 } // namespace alo
 
 // Free-function delegates for compatibility
-void ParseGo(char *line, SearchInfo *info, Board *pos) { static alo::Uci u; u.parseGo(line, info, pos); }
+void ParseGo(char *line, SearchInfo *info, Board *pos, SearchData *data) { static alo::Uci u; u.parseGo(line, info, pos, data); }
 
-void ParsePosition(const char *lineIn, Board *pos) { static alo::Uci u; u.parsePosition(lineIn, pos); }
+void ParsePosition(const char *lineIn, Board *pos, SearchData *data) { static alo::Uci u; u.parsePosition(lineIn, pos, data); }
 
 void Uci_Loop() { static alo::Uci u; u.loop(); }
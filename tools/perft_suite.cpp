@@ -196,21 +196,15 @@ static inline uint64_t perft_count(Board* pos, int depth) {
     MoveList list[1];
     GenerateAllMoves(pos, list);
 
-    if (depth == 1) {
-        uint64_t nodes = 0;
-        for (int i = 0; i < list->count; ++i) {
-            if (!MakeMove(pos, list->moves[i].move)) continue;
-            nodes++;
-            TakeMove(pos);
-        }
-        return nodes;
-    }
+    // The generator is fully legal, so leaves are counted without making them
+    if (depth == 1) return (uint64_t)list->count;
 
     uint64_t nodes = 0;
+    Board child[1];
     for (int i = 0; i < list->count; ++i) {
-        if (!MakeMove(pos, list->moves[i].move)) continue;
-        nodes += perft_count(pos, depth - 1);
-        TakeMove(pos);
+        *child = *pos;
+        MakeMove(child, list->moves[i]);
+        nodes += perft_count(child, depth - 1);
     }
     return nodes;
 }
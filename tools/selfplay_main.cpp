@@ -46,7 +46,7 @@ static void writePositionJson(std::ofstream &out,
         << "}\n";
 }
 
-// Play one self-play game, using an existing Board+SearchInfo (with TT already inited)
+// Play one self-play game, using an existing Board+SearchInfo+SearchData (with TT already inited)
 static int playOneGame(std::ofstream &out,
                        int gameId,
                        std::mt19937 &rng,
@@ -56,7 +56,8 @@ static int playOneGame(std::ofstream &out,
                        int labelDepth,
                        int labelTimeMs,
                        Board *pos,
-                       SearchInfo *info) {
+                       SearchInfo *info,
+                       SearchData *data) {
     // Reset position to startpos
     ParseFen(START_FEN, pos);
 
@@ -81,14 +82,14 @@ static int playOneGame(std::ofstream &out,
         if (list->count == 0) break;
 
         // Label with search score
-        int s = SearchScore(pos, info, labelDepth, labelTimeMs);
+        int s = SearchScore(pos, info, data, labelDepth, labelTimeMs);
         int evalCp = scoreToLabelCp(s);
         writePositionJson(out, pos, gameId, ply, evalCp);
         ++recorded;
 
         int idx = randomInt(list->count);
-        int move = list->moves[idx].move;
-        if (!MakeMove(pos, move)) break;
+        int move = list->moves[idx];
+        MakeGameMove(pos, data, move);
 
         ++ply;
     }
@@ -99,7 +100,7 @@ static int playOneGame(std::ofstream &out,
         if (list->count == 0) break;  // checkmate or stalemate
 
         // Label with search score
-        int s = SearchScore(pos, info, labelDepth, labelTimeMs);
+        int s = SearchScore(pos, info, data, labelDepth, labelTimeMs);
         int evalCp = scoreToLabelCp(s);
         writePositionJson(out, pos, gameId, ply, evalCp);
         ++recorded;
@@ -109,13 +110,13 @@ static int playOneGame(std::ofstream &out,
         int bestScore = -SCORE_INF;
 
         for (int i = 0; i < list->count; ++i) {
-            int move = list->moves[i].move;
-            if (!MakeMove(pos, move)) continue;
+            int move = list->moves[i];
+            Board child[1];
+            *child = *pos;
+            MakeMove(child, move);
 
-            int childEval = EvaluatePosition(pos); // from new side's POV
-            int scoreForCurrentSide = -childEval;  // flip back
-
-            TakeMove(pos);
+            int childEval = EvaluatePosition(child); // from new side's POV
+            int scoreForCurrentSide = -childEval;    // flip back
 
             if (bestMove == NOMOVE || scoreForCurrentSide > bestScore) {
                 bestScore = scoreForCurrentSide;
@@ -124,7 +125,7 @@ static int playOneGame(std::ofstream &out,
         }
 
         if (bestMove == NOMOVE) break;
-        if (!MakeMove(pos, bestMove)) break;
+        MakeGameMove(pos, data, bestMove);
 
         ++ply;
     }
@@ -159,8 +160,10 @@ int main(int argc, char **argv) {
 
     Board pos[1];
     SearchInfo info[1];
-    ResetBoard(pos);            
-    InitHashTable(pos->HashTable);     
+    SearchData data[1];
+    ResetBoard(pos);
+    InitHashTable(data->HashTable);
+    ClearEvalTables(data->evalTables);
 
     std::mt19937 rng(123456u);
 
@@ -179,7 +182,8 @@ int main(int argc, char **argv) {
                               labelDepth,
                               labelTimeMs,
                               pos,
-                              info);
+                              info,
+                              data);
         totalPositions += rec;
         std::fprintf(stderr, "Game %d: %d positions\n", g, rec);
     }